@@ -5,28 +5,35 @@
 #include <mancala/MCAgent.hpp>
 #include <mancala/SavageAgent.hpp>
 
+#include <cstdlib>
 #include <memory>
 #include <iostream>
 
-int main() {
+// usage: bot [memory budget in MiB] [seconds for the whole game] [ponder, 0 or 1]
+int main(int argc, char** argv) {
 	using namespace std;
 	using namespace input;
 
-	auto agent = std::unique_ptr<Agent>(new SavageAgent());
+	size_t memoryBudget = argc > 1 ? size_t(atoll(argv[1])) << 20 : SavageAgent::DEFAULT_MEMORY_BUDGET;
+
+	double gameTime = argc > 2 ? atof(argv[2]) : SavageAgent::DEFAULT_GAME_TIME;
+
+	// Think on the opponent's time unless told not to
+	bool ponder = argc > 3 ? atoi(argv[3]) != 0 : true;
+
+	auto agent = std::unique_ptr<Agent>(new SavageAgent(memoryBudget, gameTime));
 	//agent->useIterations() = false;
 	//agent->timePerMove() = 2.0;
 
-	auto msg = parseNext(cin);
+	Message msg = parseNext(cin);
 
-	Start* startMsg = dynamic_cast<Start*>(msg.get());
-
-	if(!startMsg) {
+	if(msg.type != Message::START) {
 		cerr << "Did not get start message!" << endl;
 		return -1;
 	}
 
 	Side curSide = SOUTH;
-	Side ourSide = startMsg->side;
+	Side ourSide = msg.side;
 	Side oppSide = (Side)((int)ourSide^1);
 	size_t movesPlayed = 0;
 	uint8_t lastMove = 0;
@@ -48,17 +55,17 @@ int main() {
 			}
 		}
 
-		msg = parseNext(cin);
+		if(ponder && curSide != ourSide) agent->ponder(b, curSide, movesPlayed);
 
-		Change* chng = dynamic_cast<Change*>(msg.get());
+		msg = parseNext(cin);
 
-		if(!chng) {
+		if(msg.type != Message::CHANGE) {
 			cerr << "Did not get change message!" << endl;
 			return -1;
 		}
 
 		movesPlayed++;
-		lastMove = chng->lastMove;
+		lastMove = msg.lastMove;
 
 		if(lastMove >= 7) {
 			std::swap(ourSide, oppSide);
@@ -66,11 +73,11 @@ int main() {
 			b.makeMove(curSide, lastMove);
 		}
 
-		if(!(b == chng->current)) {
+		if(!(b == msg.current)) {
 			cerr << "Boards don't match!" << endl;
 			return - 1;
 		}
 
-		curSide = chng->ourTurn ? ourSide : oppSide;
+		curSide = msg.ourTurn ? ourSide : oppSide;
 	}
 }
@@ -11,4 +11,10 @@ public:
 	/// The numbers [0, 7) represent holes to move from. Anything >= 7 represents
 	/// a pie rule switch, and is only a valid move when canSwitch is true.
 	virtual uint8_t makeMove(const Board& board, Side side, size_t movesSoFar, uint8_t lastMove) = 0;
+
+	/// Called with the board, the side to move and the moves so far while the
+	/// other side thinks. An agent can search ahead in the background until
+	/// stopPondering or its next makeMove.
+	virtual void ponder(const Board&, Side, size_t) {}
+	virtual void stopPondering() {}
 };
@@ -0,0 +1,48 @@
+#include "Arena.hpp"
+
+#include <new>
+
+#include <sys/mman.h>
+
+Arena::Arena() : Arena(0) {}
+
+Arena::Arena(size_t bytes) : mem_(nullptr), bytes_(bytes) {}
+
+Arena::~Arena() {
+	unmap();
+}
+
+void Arena::resize(size_t bytes) {
+	if(bytes == bytes_) return;
+
+	unmap();
+	bytes_ = bytes;
+}
+
+size_t Arena::size() const {
+	return bytes_;
+}
+
+void* Arena::data() {
+	if(mem_ || bytes_ == 0) return mem_;
+
+	void* m = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if(m == MAP_FAILED) throw std::bad_alloc();
+
+	#ifdef MADV_HUGEPAGE
+		// Only a hint, fewer TLB misses when walking a big tree
+		madvise(m, bytes_, MADV_HUGEPAGE);
+	#endif
+
+	mem_ = m;
+	return mem_;
+}
+
+void Arena::release() {
+	if(mem_) madvise(mem_, bytes_, MADV_DONTNEED);
+}
+
+void Arena::unmap() {
+	if(mem_) munmap(mem_, bytes_);
+	mem_ = nullptr;
+}
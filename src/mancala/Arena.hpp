@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+
+/// A big block of memory that is only paid for when it gets touched.
+///
+/// The address range is reserved with mmap(MAP_NORESERVE) the first time
+/// data() is called, so a huge arena that is mostly unused costs neither RSS
+/// nor swap. Resetting whatever lives inside is up to the owner (usually a
+/// bump pointer), the mapping itself is kept until destruction.
+class Arena {
+public:
+	Arena();
+	explicit Arena(size_t bytes);
+	~Arena();
+
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	/// Changes the size of the arena, dropping the old mapping if it differs
+	void resize(size_t bytes);
+	size_t size() const;
+
+	/// Maps the memory on first use
+	void* data();
+
+	/// Hands the touched pages back to the OS, the contents become zero
+	void release();
+
+private:
+	void* mem_;
+	size_t bytes_;
+
+	void unmap();
+};
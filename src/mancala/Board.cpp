@@ -227,6 +227,21 @@ std::string Board::toString() const {
 	return buf.str();
 }
 
+Board Board::mirrored() const {
+	Board m;
+	memcpy(m.nHoles_, sHoles_, 7);
+	memcpy(m.sHoles_, nHoles_, 7);
+	m.sScore_ = nScore_;
+	m.nScore_ = sScore_;
+
+	memcpy(m.nMoves_, sMoves_, 7);
+	memcpy(m.sMoves_, nMoves_, 7);
+	m.noNMoves_ = noSMoves_;
+	m.noSMoves_ = noNMoves_;
+
+	return m;
+}
+
 bool operator==(const Board& b1, const Board& b2) {
 	return memcmp(&b1, &b2, 16) == 0;
 }
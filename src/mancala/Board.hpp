@@ -27,6 +27,9 @@ public:
 
 	bool makeMove(Side side, size_t holeNo);
 
+	/// The same position with the two rows and wells swapped
+	Board mirrored() const;
+
 	inline const uint8_t* validMoves(Side side, size_t& nMoves) const;
 
 	std::string toString() const;
@@ -51,6 +54,14 @@ private:
 
 bool operator==(const Board& b1, const Board& b2);
 
+/// The position as the side to move sees it: b itself for south, mirrored
+/// for north. Swapping the sides is an exact symmetry of the game, so tables
+/// keyed by this only ever need positions with south to move, and moves
+/// (which are holes of the mover) carry over unchanged.
+inline Board canonical(const Board& b, Side toMove) {
+	return toMove == SOUTH ? b : b.mirrored();
+}
+
 inline uint8_t Board::stonesInHole(Side side, size_t holeNo) const {
 	assert(side == SOUTH || side == NORTH);
 	assert(holeNo < 7);
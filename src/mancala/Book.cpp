@@ -0,0 +1,228 @@
+#include "Book.hpp"
+#include "bookhash.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const uint8_t Book::NO_MOVE;
+const uint16_t Book::VERSION;
+const size_t Book::HEADER_BYTES;
+const size_t Book::KEY_BYTES;
+const size_t Book::ENTRY_BYTES;
+constexpr float Book::NO_VALUE;
+
+static const char MAGIC[4] = { 'M', 'K', 'B', 'K' };
+
+static uint32_t readU32(const uint8_t* p) {
+	return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+
+static uint16_t readU16(const uint8_t* p) {
+	return uint16_t(p[0] | p[1] << 8);
+}
+
+static void writeU32(uint8_t* p, uint32_t v) {
+	for(size_t i = 0; i < 4; i++) p[i] = uint8_t(v >> (8 * i));
+}
+
+static void writeU16(uint8_t* p, uint16_t v) {
+	p[0] = uint8_t(v);
+	p[1] = uint8_t(v >> 8);
+}
+
+void Book::key(const Board& b, uint8_t* key) {
+	for(size_t i = 0; i < 7; i++) {
+		key[i] = b.stonesInHole(SOUTH, i);
+		key[7 + i] = b.stonesInHole(NORTH, i);
+	}
+	key[14] = b.stonesInWell(SOUTH);
+	key[15] = b.stonesInWell(NORTH);
+}
+
+Board Book::board(const uint8_t* key) {
+	Board b;
+	b.clear();
+	for(size_t i = 0; i < 7; i++) {
+		b.stonesInHole(SOUTH, i) = key[i];
+		b.stonesInHole(NORTH, i) = key[7 + i];
+	}
+	b.stonesInWell(SOUTH) = key[14];
+	b.stonesInWell(NORTH) = key[15];
+	b.recalcMoves();
+
+	return b;
+}
+
+Book::Book() : entries_(nullptr), count_(0), checksum_(0), map_(nullptr), mapBytes_(0) {}
+
+Book::~Book() {
+	unmap();
+}
+
+Book::Book(Book&& o) : Book() {
+	*this = std::move(o);
+}
+
+Book& Book::operator=(Book&& o) {
+	if(this != &o) {
+		unmap();
+
+		entries_ = o.entries_;
+		count_ = o.count_;
+		checksum_ = o.checksum_;
+		map_ = o.map_;
+		mapBytes_ = o.mapBytes_;
+
+		o.entries_ = nullptr;
+		o.count_ = 0;
+		o.map_ = nullptr;
+		o.mapBytes_ = 0;
+	}
+
+	return *this;
+}
+
+Book Book::view(const void* data, size_t bytes) {
+	Book book;
+	const uint8_t* p = (const uint8_t*) data;
+
+	if(bytes < HEADER_BYTES || memcmp(p, MAGIC, sizeof(MAGIC)) != 0) return book;
+	if(readU16(p + 4) != VERSION || readU16(p + 6) != ENTRY_BYTES) return book;
+
+	uint32_t count = readU32(p + 8);
+	if(bytes != HEADER_BYTES + size_t(count) * ENTRY_BYTES) return book;
+
+	book.entries_ = p + HEADER_BYTES;
+	book.count_ = count;
+	book.checksum_ = readU32(p + 12);
+
+	return book;
+}
+
+Book Book::open(const std::string& path) {
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if(fd < 0) return Book();
+
+	struct stat st;
+	void* m = MAP_FAILED;
+	if(fstat(fd, &st) == 0 && st.st_size > 0) {
+		m = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+
+	if(m == MAP_FAILED) return Book();
+
+	Book book = view(m, st.st_size);
+	if(!book.valid()) {
+		munmap(m, st.st_size);
+		return Book();
+	}
+
+	book.map_ = m;
+	book.mapBytes_ = st.st_size;
+
+	return book;
+}
+
+std::vector<uint8_t> Book::encode(std::vector<std::pair<Board, uint8_t>> entries, const std::vector<float>& values) {
+	// The key, then the move and the packed value
+	typedef std::pair<std::string, std::pair<uint8_t, uint16_t>> Keyed;
+	std::vector<Keyed> keyed;
+	keyed.reserve(entries.size());
+
+	for(size_t i = 0; i < entries.size(); i++) {
+		uint8_t k[KEY_BYTES];
+		key(entries[i].first, k);
+
+		uint16_t v = i < values.size() ? bookhash::packValue(values[i]) : bookhash::NO_VALUE;
+		keyed.emplace_back(std::string((const char*) k, KEY_BYTES), std::make_pair(entries[i].second, v));
+	}
+
+	// std::string compares like memcmp, which is what find relies on
+	std::sort(keyed.begin(), keyed.end());
+	keyed.erase(std::unique(keyed.begin(), keyed.end(), [](const Keyed& a, const Keyed& b) {
+		return a.first == b.first;
+	}), keyed.end());
+
+	std::vector<uint8_t> out(HEADER_BYTES + keyed.size() * ENTRY_BYTES);
+	uint8_t* p = out.data();
+
+	memcpy(p, MAGIC, sizeof(MAGIC));
+	writeU16(p + 4, VERSION);
+	writeU16(p + 6, ENTRY_BYTES);
+	writeU32(p + 8, uint32_t(keyed.size()));
+
+	uint8_t* e = p + HEADER_BYTES;
+	for(const auto& k : keyed) {
+		memcpy(e, k.first.data(), KEY_BYTES);
+		e[KEY_BYTES] = k.second.first;
+		writeU16(e + KEY_BYTES + 1, k.second.second);
+		e += ENTRY_BYTES;
+	}
+
+	writeU32(p + 12, bookhash::fnv1a(p + HEADER_BYTES, keyed.size() * ENTRY_BYTES));
+
+	return out;
+}
+
+bool Book::valid() const {
+	return entries_ != nullptr;
+}
+
+bool Book::verify() const {
+	return valid() && bookhash::fnv1a(entries_, size_t(count_) * ENTRY_BYTES) == checksum_;
+}
+
+size_t Book::size() const {
+	return count_;
+}
+
+std::pair<Board, uint8_t> Book::entry(size_t i) const {
+	const uint8_t* e = entries_ + i * ENTRY_BYTES;
+	return std::make_pair(board(e), e[KEY_BYTES]);
+}
+
+float Book::value(size_t i) const {
+	return bookhash::unpackValue(readU16(entries_ + i * ENTRY_BYTES + KEY_BYTES + 1));
+}
+
+uint8_t Book::find(const Board& b) const {
+	const uint8_t* e = lookup(b);
+	return e ? e[KEY_BYTES] : NO_MOVE;
+}
+
+float Book::value(const Board& b) const {
+	const uint8_t* e = lookup(b);
+	return e ? bookhash::unpackValue(readU16(e + KEY_BYTES + 1)) : NO_VALUE;
+}
+
+const uint8_t* Book::lookup(const Board& b) const {
+	uint8_t k[KEY_BYTES];
+	key(b, k);
+
+	// Binary search straight over the entries
+	size_t lo = 0, hi = count_;
+	while(lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		const uint8_t* e = entries_ + mid * ENTRY_BYTES;
+
+		int c = memcmp(e, k, KEY_BYTES);
+		if(c == 0) return e;
+
+		if(c < 0) lo = mid + 1;
+		else      hi = mid;
+	}
+
+	return nullptr;
+}
+
+void Book::unmap() {
+	if(map_) munmap(map_, mapBytes_);
+	map_ = nullptr;
+	mapBytes_ = 0;
+}
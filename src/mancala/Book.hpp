@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Board.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// An opening book that is probed where it lies, in a mapped file or in bytes
+/// compiled into the binary, without being parsed first.
+///
+/// Layout, all integers little endian:
+///
+///     0  "MKBK"
+///     4  u16 version
+///     6  u16 entry size, ENTRY_BYTES
+///     8  u32 number of entries
+///    12  u32 FNV-1a of the entries
+///    16  entries, sorted by key
+///
+/// An entry is a 16 byte key, the move and a u16 value. The key is south's
+/// holes, north's holes, south's well and north's well, one byte each. The
+/// value is the side to move's chance to win in steps of 1/0xfffe, or 0xffff
+/// if the book doesn't know it.
+class Book {
+public:
+	static const uint8_t NO_MOVE = 0xff;
+	static const uint16_t VERSION = 2;
+	static const size_t HEADER_BYTES = 16;
+	static const size_t KEY_BYTES = 16;
+	static const size_t ENTRY_BYTES = KEY_BYTES + 3;
+	/// What value gives back for a position without one
+	static constexpr float NO_VALUE = -1.0f;
+
+	/// An empty book
+	Book();
+	~Book();
+
+	Book(Book&& o);
+	Book& operator=(Book&& o);
+	Book(const Book&) = delete;
+	Book& operator=(const Book&) = delete;
+
+	/// Uses the bytes in place, they have to outlive the book
+	static Book view(const void* data, size_t bytes);
+	/// Maps a book file read only. Every process that opens the same file
+	/// shares its pages.
+	static Book open(const std::string& path);
+
+	/// The bytes of a book with these entries. values, if given, go with the
+	/// entries at the same index, a negative one means there is none.
+	static std::vector<uint8_t> encode(std::vector<std::pair<Board, uint8_t>> entries,
+	                                   const std::vector<float>& values = std::vector<float>());
+
+	/// Whether the header made sense. Anything else is an empty book.
+	bool valid() const;
+	/// Checks the entries against the checksum, this reads the whole book
+	bool verify() const;
+
+	size_t size() const;
+	std::pair<Board, uint8_t> entry(size_t i) const;
+	float value(size_t i) const;
+
+	/// The move for this position, or NO_MOVE
+	uint8_t find(const Board& b) const;
+	/// The value of this position for the side to move, or NO_VALUE
+	float value(const Board& b) const;
+
+	/// Writes the KEY_BYTES long key of b
+	static void key(const Board& b, uint8_t* key);
+	/// The position a key stands for
+	static Board board(const uint8_t* key);
+
+private:
+	const uint8_t* entries_;
+	uint32_t count_;
+	uint32_t checksum_;
+
+	// Only set for mapped files
+	void* map_;
+	size_t mapBytes_;
+
+	void unmap();
+	/// The entry with this position's key, or nullptr
+	const uint8_t* lookup(const Board& b) const;
+};
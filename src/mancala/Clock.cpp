@@ -0,0 +1,75 @@
+#include "Clock.hpp"
+
+#include <algorithm>
+
+// Measured in MCAgent self-play: a side has about one move left for every
+// three stones still in the holes
+static const double STONES_PER_MOVE = 3.0;
+static const double MIN_MOVES_LEFT = 2.0;
+
+// No move takes more than this fraction of the time left
+static const double MAX_SHARE = 0.25;
+// Even a nearly flagged clock gets to make a move
+static const double MIN_BUDGET = 0.05;
+
+// Weight of the latest move in the overrun average
+static const double OVERRUN_WEIGHT = 0.25;
+
+Clock::Clock(double totalTime, double increment, double safetyMargin)
+	: total_(totalTime), increment_(increment), margin_(safetyMargin) {
+	reset();
+}
+
+void Clock::reset() {
+	remaining_ = total_;
+	budget_ = 0.0;
+	overrun_ = 1.0;
+}
+
+double Clock::remaining() const {
+	return remaining_;
+}
+
+double Clock::startMove(const Board& b, Side toMove) {
+	started_ = std::chrono::steady_clock::now();
+
+	size_t nMoves;
+	b.validMoves(toMove, nMoves);
+
+	double stones = 0;
+	for(size_t i = 0; i < 7; i++) {
+		stones += b.stonesInHole(SOUTH, i) + b.stonesInHole(NORTH, i);
+	}
+
+	const double movesLeft = MIN_MOVES_LEFT + stones / STONES_PER_MOVE;
+	const double usable = remaining_ - margin_;
+
+	// Nothing to think about
+	if(nMoves <= 1 || usable <= 0) {
+		budget_ = MIN_BUDGET;
+		return budget_;
+	}
+
+	// 0.7x with two moves to pick from up to 1.2x with all seven
+	double complexity = 0.5 + nMoves / 10.0;
+
+	double budget = (usable / movesLeft + increment_) * complexity / overrun_;
+	budget_ = std::max(MIN_BUDGET, std::min(budget, usable * MAX_SHARE));
+
+	return budget_;
+}
+
+void Clock::endMove() {
+	endMove(std::chrono::duration<double>(std::chrono::steady_clock::now() - started_).count());
+}
+
+void Clock::endMove(double seconds) {
+	remaining_ += increment_ - seconds;
+
+	// Only ever shrink budgets, moves that finish early just leave more time
+	// for the rest of the game
+	if(budget_ > 0) {
+		double ratio = std::max(1.0, seconds / budget_);
+		overrun_ += OVERRUN_WEIGHT * (ratio - overrun_);
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Board.hpp"
+
+#include <chrono>
+
+/// Splits the time one player has for a whole game between its moves.
+///
+/// Each move gets an even share of what is left over the moves the game is
+/// still expected to last, judged by the stones left in holes. The share goes
+/// up with how many moves there are to choose from. It goes down when earlier
+/// moves took longer than they were given. safetyMargin seconds are never
+/// handed out, and no single move gets more than a quarter of what is left.
+class Clock {
+public:
+	explicit Clock(double totalTime, double increment = 0.0, double safetyMargin = 5.0);
+
+	/// Back to a full clock for a new game
+	void reset();
+
+	/// Seconds left on the clock
+	double remaining() const;
+
+	/// Starts timing a move and returns how long it should take
+	double startMove(const Board& b, Side toMove);
+
+	/// Charges the time since startMove
+	void endMove();
+	/// Charges the given number of seconds instead of the measured ones
+	void endMove(double seconds);
+
+private:
+	double total_;
+	double increment_;
+	double margin_;
+
+	double remaining_;
+	double budget_;
+	// How much longer than their budget moves have been taking, on average
+	double overrun_;
+
+	std::chrono::steady_clock::time_point started_;
+};
@@ -1,7 +1,10 @@
 #include "MCAgent.hpp"
 
 #include "RandomAgent.hpp"
-#include "Game.hpp"
+#include "playout.hpp"
+#include "batchplayout.hpp"
+#include "heuristics.hpp"
+#include "books.hpp"
 
 #include <cassert>
 #include <random>
@@ -11,21 +14,124 @@
 #include <tuple>
 #include <chrono>
 #include <iostream>
+#include <new>
+#include <vector>
+#include <cstring>
+
+const uint8_t MCAgent::NO_MOVE;
+
+// Marks an unexpanded child, and the end of the free list
+static const uint32_t NO_NODE = ~0u;
+
+// Game theoretic value of a node, once known it never changes
+enum Proof : uint8_t { UNPROVEN = 0, SOUTH_WINS, NORTH_WINS, DRAWN };
+
+static inline Proof winFor(Side s) {
+	return s == SOUTH ? SOUTH_WINS : NORTH_WINS;
+}
 
 struct UCB {
 	Board board;
 	uint32_t plays = 0;
 	uint32_t wins[2] = { 0 };
-	uint32_t childIdxs[7] = { 0 };
-	Side whosTurn;
+	// The first entry doubles as the next pointer while the node is free
+	uint32_t childIdxs[7] = { NO_NODE, NO_NODE, NO_NODE, NO_NODE, NO_NODE, NO_NODE, NO_NODE };
+	uint8_t whosTurn;
+	uint8_t proven = UNPROVEN;
+	uint8_t mark = 0;
+	// Whether the hybrid alpha-beta has been run here
+	uint8_t searched = 0;
+};
+
+/// How often each move of a node has been followed. Once transpositions are
+/// shared a child can have several parents, so its own plays say nothing
+/// about how often this particular parent tried it.
+struct EdgePlays {
+	uint32_t plays[7] = { 0 };
 };
 
+/// All-moves-as-first statistics for the side to move, by hole. Every
+/// simulation through the node in which that side moved from a hole at some
+/// point counts for the hole, not just the ones that started with it.
+struct AmafStats {
+	uint32_t plays[7] = { 0 };
+	uint32_t wins[7] = { 0 };
+};
+
+/// The search graph and what montecarlo needs to grow it. edges and index are
+/// only there when transpositions are shared, otherwise every node has
+/// exactly one parent and the graph is a plain tree. amaf is only there with
+/// RAVE.
+struct Tree {
+	UCB* ucbs;
+	EdgePlays* edges;
+	AmafStats* amaf;
+	float raveK;
+
+	MCAgent::LeafMode leafMode;
+	uint32_t rolloutPlies;
+	float evalScale;
+
+	uint8_t hybridDepth;
+	uint32_t hybridVisits;
+	uint32_t hybridPrior;
+	MiniMaxAgent::MoveCache* mmCache;
+	uint32_t bookPrior;
+	// Open addressing, node + 1 for every position in the graph and 0 for a free slot
+	uint32_t* index;
+	size_t indexBits;
+	Arena* indexArena;
+
+	// Nodes come off the free list first, then the bump pointer. Once both
+	// are empty outOfNodes asks for a collection, unless the last one failed.
+	uint32_t used;
+	uint32_t len;
+	uint32_t freeList;
+	bool outOfNodes;
+	bool canCollect;
+
+	// Every node on the way down and the move taken there, kept between
+	// iterations so it is only allocated once
+	std::vector<std::pair<uint32_t, uint8_t>> path;
+	size_t simulations;
+};
+
+static inline uint32_t alloc(Tree& t) {
+	uint32_t idx;
+	if(t.freeList != NO_NODE) {
+		idx = t.freeList;
+		t.freeList = t.ucbs[idx].childIdxs[0];
+	} else if(t.used < t.len) {
+		idx = t.used++;
+	} else {
+		t.outOfNodes = t.canCollect;
+		return NO_NODE;
+	}
+
+	new (&t.ucbs[idx]) UCB();
+	if(t.edges) new (&t.edges[idx]) EdgePlays();
+	if(t.amaf) new (&t.amaf[idx]) AmafStats();
+	return idx;
+}
+
 static inline Side opposite(Side s) {
 	return (Side)(((int)s) ^ 1);
 }
 
+static inline size_t bitLength(uint32_t n) {
+	return n == 0 ? 0 : 32 - __builtin_clz(n);
+}
+
+// At most half full, so linear probing stays short
+static inline size_t indexBitsFor(size_t nodes) {
+	return bitLength(uint32_t(2 * nodes - 1));
+}
+
 MCAgent::MCAgent(uint32_t bufSize, uint16_t ucbBaseGames, uint32_t iterations)
-	: bufSize_(bufSize), baseGames_(ucbBaseGames), iterations_(iterations), timePerMove_(1.0), useIterations_(true)
+	: bufSize_(bufSize), baseGames_(ucbBaseGames), iterations_(iterations), timePerMove_(1.0), useIterations_(true),
+	  manageTime_(true), useTranspositions_(false), useRave_(false), raveEquivalence_(30), leafMode_(ROLLOUT), rolloutPlies_(8),
+	  evalScale_(0.03f), hybridDepth_(0), hybridVisits_(16), hybridPrior_(8), bookPrior_(0), stop_(nullptr), nodes_(), edges_(), index_(), amaf_(),
+	  nodesUsed_(0), root_(NO_NODE), freeList_(NO_NODE), treeIsDag_(false), treeHasRave_(false)
 {}
 
 uint32_t& MCAgent::bufferSize() {
@@ -48,14 +154,374 @@ bool& MCAgent::useIterations() {
 	return useIterations_;
 }
 
-static std::tuple<uint32_t, uint32_t> montecarlo(UCB* ucbs, size_t idx, size_t baseGames, std::function<uint32_t()>& alloc);
+bool& MCAgent::manageTime() {
+	return manageTime_;
+}
+
+bool& MCAgent::useTranspositions() {
+	return useTranspositions_;
+}
+
+bool& MCAgent::useRave() {
+	return useRave_;
+}
+
+float& MCAgent::raveEquivalence() {
+	return raveEquivalence_;
+}
+
+MCAgent::LeafMode& MCAgent::leafMode() {
+	return leafMode_;
+}
+
+uint32_t& MCAgent::rolloutPlies() {
+	return rolloutPlies_;
+}
+
+float& MCAgent::evalScale() {
+	return evalScale_;
+}
+
+uint8_t& MCAgent::hybridDepth() {
+	return hybridDepth_;
+}
+
+uint32_t& MCAgent::hybridVisits() {
+	return hybridVisits_;
+}
+
+uint32_t& MCAgent::hybridPrior() {
+	return hybridPrior_;
+}
+
+uint32_t& MCAgent::bookPrior() {
+	return bookPrior_;
+}
+
+const std::atomic<bool>*& MCAgent::stop() {
+	return stop_;
+}
+
+static void montecarlo(Tree& t, uint32_t root, size_t baseGames);
+static void addBookPrior(const Tree& t, UCB& cur);
+
+// Below this many plays log comes from a table, which covers all but the few
+// most visited nodes near the root
+static const size_t LOG_TABLE_SIZE = 4096;
+
+struct LogTable {
+	float v[LOG_TABLE_SIZE];
+
+	LogTable() {
+		v[0] = 0;
+		for(size_t i = 1; i < LOG_TABLE_SIZE; i++) v[i] = log(double(i));
+	}
+};
+
+static const LogTable LOGS;
+
+static inline float logOf(uint32_t n) {
+	return n < LOG_TABLE_SIZE ? LOGS.v[n] : std::log(float(n));
+}
+
+static inline size_t slotFor(const Board& b, Side s, size_t bits) {
+	uint64_t h = uint64_t(std::hash<Board>()(b)) * 2 + s;
+
+	// Fibonacci hashing, spreads the hash over the top bits
+	return size_t((h * 0x9e3779b97f4a7c15ull) >> (64 - bits));
+}
+
+static uint32_t lookup(const Tree& t, const Board& b, Side s) {
+	const size_t mask = (size_t(1) << t.indexBits) - 1;
+
+	for(size_t i = slotFor(b, s, t.indexBits);; i = (i + 1) & mask) {
+		uint32_t entry = t.index[i];
+		if(entry == 0) return NO_NODE;
+
+		const UCB& node = t.ucbs[entry - 1];
+		if(node.whosTurn == s && node.board == b) return entry - 1;
+	}
+}
+
+static void insert(Tree& t, uint32_t idx) {
+	const size_t mask = (size_t(1) << t.indexBits) - 1;
+	const UCB& node = t.ucbs[idx];
+
+	size_t i = slotFor(node.board, Side(node.whosTurn), t.indexBits);
+	while(t.index[i] != 0) i = (i + 1) & mask;
+
+	t.index[i] = idx + 1;
+}
+
+// How many plies below the old root we look for the new one. This covers our
+// move, the opponent's reply and a couple of extra turns on either side.
+static const size_t REROOT_DEPTH = 6;
+
+/// Depth limited search of the kept tree, returns NO_NODE if the position isn't in it
+static uint32_t findNode(const Tree& t, uint32_t root, const Board& b, Side s) {
+	if(root == NO_NODE) return NO_NODE;
+
+	// Everything reachable from the root is indexed
+	if(t.index) return lookup(t, b, s);
+
+	std::vector<std::pair<uint32_t, size_t>> stack;
+	stack.emplace_back(root, 0);
+
+	while(!stack.empty()) {
+		uint32_t idx = stack.back().first;
+		size_t depth = stack.back().second;
+		stack.pop_back();
+
+		const UCB& cur = t.ucbs[idx];
+		if(cur.whosTurn == s && cur.board == b) return idx;
+
+		// Stones never leave a well, so there is no way back down from here
+		if(cur.board.stonesInWell(SOUTH) > b.stonesInWell(SOUTH) ||
+		   cur.board.stonesInWell(NORTH) > b.stonesInWell(NORTH)) continue;
+
+		if(depth == REROOT_DEPTH) continue;
+
+		for(size_t i = 0; i < 7; i++) {
+			if(cur.childIdxs[i] != NO_NODE) stack.emplace_back(cur.childIdxs[i], depth + 1);
+		}
+	}
+
+	return NO_NODE;
+}
+
+/// Moves the graph under newRoot to the front of the buffer and drops
+/// everything else, free nodes included. Returns the number of nodes still in
+/// use, root is set to newRoot's new index.
+static uint32_t reroot(Tree& t, uint32_t used, uint32_t newRoot, uint32_t& root) {
+	UCB* ucbs = t.ucbs;
+
+	// Kept nodes get new indices in their old order, so every node moves
+	// towards the front and nothing gets overwritten before it has been copied
+	std::vector<uint32_t> remap(used, NO_NODE);
+	std::vector<uint32_t> stack(1, newRoot);
+
+	remap[newRoot] = 0;
+	while(!stack.empty()) {
+		uint32_t idx = stack.back();
+		stack.pop_back();
+
+		for(size_t i = 0; i < 7; i++) {
+			uint32_t c = ucbs[idx].childIdxs[i];
+			if(c == NO_NODE || remap[c] != NO_NODE) continue;
+
+			remap[c] = 0;
+			stack.push_back(c);
+		}
+	}
+
+	uint32_t kept = 0;
+	for(uint32_t i = 0; i < used; i++) {
+		if(remap[i] != NO_NODE) remap[i] = kept++;
+	}
+
+	for(uint32_t i = 0; i < used; i++) {
+		if(remap[i] == NO_NODE) continue;
+
+		UCB node = ucbs[i];
+		for(size_t j = 0; j < 7; j++) {
+			if(node.childIdxs[j] != NO_NODE) node.childIdxs[j] = remap[node.childIdxs[j]];
+		}
+		ucbs[remap[i]] = node;
+
+		if(t.edges) t.edges[remap[i]] = t.edges[i];
+		if(t.amaf) t.amaf[remap[i]] = t.amaf[i];
+	}
+
+	if(t.index) {
+		t.indexArena->release();
+		for(uint32_t i = 0; i < kept; i++) insert(t, i);
+	}
+
+	root = remap[newRoot];
+	return kept;
+}
+
+/// Makes room in a full buffer by collapsing the least visited nodes back into
+/// leaves. Every node with fewer than 2^k plays loses its children, k being the
+/// smallest cutoff that frees at least half of the tree. Collapsed nodes keep
+/// their own statistics and simply get expanded again if the search comes back.
+/// Returns the number of nodes added to the free list.
+static uint32_t collect(Tree& t, uint32_t used, uint32_t root, uint32_t& freeList) {
+	enum { UNSEEN = 0, COUNTED = 1, KEPT = 2 };
+	UCB* ucbs = t.ucbs;
+
+	// How many nodes would go if we collapsed everything under a given bit length
+	uint32_t freeable[33] = { 0 };
+	uint32_t live = 0;
+	std::vector<uint32_t> stack(1, root);
+
+	ucbs[root].mark = COUNTED;
+	while(!stack.empty()) {
+		const UCB& cur = ucbs[stack.back()];
+		stack.pop_back();
+		live++;
+
+		for(size_t i = 0; i < 7; i++) {
+			uint32_t c = cur.childIdxs[i];
+			if(c == NO_NODE || ucbs[c].mark == COUNTED) continue;
+
+			ucbs[c].mark = COUNTED;
+			freeable[bitLength(cur.plays)]++;
+			stack.push_back(c);
+		}
+	}
+
+	// Never collapse the root itself
+	size_t cutoff = 0;
+	uint32_t toFree = 0;
+	while(cutoff + 1 < bitLength(ucbs[root].plays) && toFree < live / 2) {
+		toFree += freeable[++cutoff];
+	}
+
+	// With transpositions a collapsed node's children can survive through
+	// another parent, they only go once nothing links to them any more
+	stack.push_back(root);
+	ucbs[root].mark = KEPT;
+	while(!stack.empty()) {
+		uint32_t idx = stack.back();
+		UCB& cur = ucbs[idx];
+		stack.pop_back();
+
+		bool collapse = idx != root && bitLength(cur.plays) <= cutoff;
+		if(collapse && t.edges) t.edges[idx] = EdgePlays();
+
+		// A won or drawn node is never searched again, but if it becomes the
+		// root it still has to say which move wins or draws. It keeps the
+		// first child that proves it.
+		uint8_t keep = cur.proven == winFor(Side(cur.whosTurn)) || cur.proven == DRAWN ? cur.proven : uint8_t(UNPROVEN);
+
+		for(size_t i = 0; i < 7; i++) {
+			uint32_t c = cur.childIdxs[i];
+			if(c == NO_NODE) continue;
+
+			if(collapse) {
+				if(keep == UNPROVEN || ucbs[c].proven != keep) {
+					cur.childIdxs[i] = NO_NODE;
+					continue;
+				}
+				keep = UNPROVEN;
+			}
+
+			if(ucbs[c].mark != KEPT) {
+				ucbs[c].mark = KEPT;
+				stack.push_back(c);
+			}
+		}
+	}
+
+	if(t.index) t.indexArena->release();
+
+	uint32_t freed = 0;
+	freeList = NO_NODE;
+	for(uint32_t i = used; i-- > 0;) {
+		if(ucbs[i].mark == KEPT) {
+			ucbs[i].mark = UNSEEN;
+			if(t.index) insert(t, i);
+		} else {
+			ucbs[i].childIdxs[0] = freeList;
+			freeList = i;
+			freed++;
+		}
+	}
+
+	return freed;
+}
+
+static Tree view(Arena& nodes, Arena& edges, Arena& index, Arena& amaf, bool dag, bool rave) {
+	Tree t;
+	t.ucbs = static_cast<UCB*>(nodes.data());
+	t.edges = dag ? static_cast<EdgePlays*>(edges.data()) : nullptr;
+	t.amaf = rave ? static_cast<AmafStats*>(amaf.data()) : nullptr;
+	t.index = dag ? static_cast<uint32_t*>(index.data()) : nullptr;
+	t.indexBits = dag ? bitLength(uint32_t(index.size() / sizeof(uint32_t))) - 1 : 0;
+	t.indexArena = &index;
+
+	return t;
+}
+
+// How often the time manager checks whether the search can stop, in seconds
+static const double CHECK_INTERVAL = 0.05;
+
+// When time runs out with the runner up this close to the most played move,
+// the search goes on for another EXTENSION of the time per move
+static const double CLOSE_RACE = 0.9;
+static const double EXTENSION = 0.5;
+
+/// Plays of the two most played moves at the root, the ones the final choice
+/// would pick from. Proven losses and draws aren't picked by their plays, so
+/// they count as 0.
+static void topTwo(const Tree& t, uint32_t root, size_t nMoves, Side s, uint32_t& first, uint32_t& second) {
+	first = second = 0;
+
+	for(size_t i = 0; i < nMoves; i++) {
+		uint32_t c = t.ucbs[root].childIdxs[i];
+		if(c == NO_NODE || t.ucbs[c].proven == winFor(opposite(s)) || t.ucbs[c].proven == DRAWN) continue;
+
+		uint32_t plays = t.edges ? t.edges[root].plays[i] : t.ucbs[c].plays;
+		if(plays > first) {
+			second = first;
+			first = plays;
+		} else if(plays > second) {
+			second = plays;
+		}
+	}
+}
+
+size_t MCAgent::bytesPerNode() const {
+	size_t bytes = sizeof(UCB);
+
+	// The index has between 2 and 4 slots per node
+	if(useTranspositions_) bytes += sizeof(EdgePlays) + 4 * sizeof(uint32_t);
+	if(useRave_)           bytes += sizeof(AmafStats);
+
+	return bytes;
+}
+
+bool MCAgent::treeFits() const {
+	return nodes_.size() == bufSize_ * sizeof(UCB) && treeIsDag_ == useTranspositions_ && treeHasRave_ == useRave_;
+}
+
+bool MCAgent::hasTreeFor(const Board& b, Side s) {
+	if(!treeFits() || root_ == NO_NODE) return false;
+
+	return findNode(view(nodes_, edges_, index_, amaf_, treeIsDag_, treeHasRave_), root_, b, s) != NO_NODE;
+}
+
+uint8_t MCAgent::mostPlayed(const Board& b, Side s) {
+	if(!treeFits() || root_ == NO_NODE) return NO_MOVE;
+
+	Tree t = view(nodes_, edges_, index_, amaf_, treeIsDag_, treeHasRave_);
+	uint32_t idx = findNode(t, root_, b, s);
+	if(idx == NO_NODE) return NO_MOVE;
+
+	size_t nMoves;
+	const uint8_t* moves = t.ucbs[idx].board.validMoves(s, nMoves);
+
+	uint8_t best = NO_MOVE;
+	uint32_t most = 0;
+	for(size_t i = 0; i < nMoves; i++) {
+		uint32_t c = t.ucbs[idx].childIdxs[i];
+		if(c == NO_NODE) continue;
+
+		uint32_t plays = t.edges ? t.edges[idx].plays[i] : t.ucbs[c].plays;
+		if(plays > most) {
+			most = plays;
+			best = moves[i];
+		}
+	}
+
+	return best;
+}
 
 uint8_t MCAgent::makeMove(const Board& b, Side s, size_t movesSoFar, uint8_t lastMove) {
 	return makeMoveAndScore(b, s, movesSoFar, lastMove).first;
 }
 
-static size_t leaves = 0;
-
 std::pair<uint8_t, float> MCAgent::makeMoveAndScore(const Board& b, Side s, size_t movesSoFar, uint8_t lastMove) {
 	using namespace std::chrono;
 
@@ -71,201 +537,493 @@ std::pair<uint8_t, float> MCAgent::makeMoveAndScore(const Board& b, Side s, size
 		return std::make_pair(RandomAgent().makeMove(b, s, movesSoFar, lastMove), 0.0);
 	}
 
-	size_t len = bufSize_;
-	auto ucbs = std::unique_ptr<UCB[]>(new UCB[len]);
+	// The arena is only mapped once, resetting it is just rewinding the bump pointer.
+	// Nodes get constructed as they are handed out, so stale ones are never seen.
+	// A tree and a graph with shared transpositions can't be mixed, and a tree
+	// without AMAF statistics can't be used for RAVE. Switching either
+	// starts from scratch.
+	const size_t len = bufSize_;
+	if(!treeFits()) {
+		nodes_.resize(len * sizeof(UCB));
+		edges_.resize(useTranspositions_ ? len * sizeof(EdgePlays) : 0);
+		index_.resize(useTranspositions_ ? sizeof(uint32_t) << indexBitsFor(len) : 0);
+		amaf_.resize(useRave_ ? len * sizeof(AmafStats) : 0);
+		treeIsDag_ = useTranspositions_;
+		treeHasRave_ = useRave_;
+		root_ = NO_NODE;
+	}
+
+	Tree t = view(nodes_, edges_, index_, amaf_, treeIsDag_, treeHasRave_);
+	t.raveK = raveEquivalence_;
+	t.leafMode = leafMode_;
+	t.rolloutPlies = rolloutPlies_;
+	t.evalScale = evalScale_;
+	t.hybridDepth = hybridDepth_;
+	t.hybridVisits = hybridVisits_;
+	t.hybridPrior = hybridPrior_;
+	t.mmCache = &mmCache_;
+	t.bookPrior = bookPrior_;
+	UCB* ucbs = t.ucbs;
+
+	// Keep whatever we already know about this position from the last search
+	uint32_t newRoot = findNode(t, root_, b, s);
+	nodesUsed_ = newRoot == NO_NODE ? 0 : reroot(t, nodesUsed_, newRoot, root_);
+	freeList_ = NO_NODE;
+	std::cerr << "reused " << nodesUsed_ << std::endl;
+
+	// Once the buffer is full the iteration that noticed finishes with a playout
+	// and the tree gets pruned before the next one starts. If pruning can't free
+	// anything we stop growing the tree instead of pruning over and over.
+	t.used = nodesUsed_;
+	t.len = len;
+	t.freeList = freeList_;
+	t.outOfNodes = false;
+	t.canCollect = true;
+	t.simulations = 0;
+
+	if(t.used == 0) {
+		if(t.index) index_.release();
+
+		root_ = alloc(t);
+		ucbs[root_].board = b;
+		ucbs[root_].whosTurn = s;
+		if(t.index) insert(t, root_);
+		if(t.bookPrior) addBookPrior(t, ucbs[root_]);
+	}
+
+	// A won or drawn root has to show the child that proves it. The hybrid
+	// search proves the child it plays without expanding it any further, so
+	// behind an extra turn there can be none, and the root is searched again.
+	const uint8_t rootProof = ucbs[root_].proven;
+	if(rootProof == winFor(s) || rootProof == DRAWN) {
+		bool shown = false;
+		for(uint32_t c : ucbs[root_].childIdxs) shown |= c != NO_NODE && ucbs[c].proven == rootProof;
+		if(!shown) ucbs[root_].proven = UNPROVEN;
+	}
 
+	// Children are ordered like the moves of the board they were expanded from,
+	// which for a reused root isn't necessarily the same as b's order
 	size_t nMoves;
-	const uint8_t* moves = b.validMoves(s, nMoves);
+	const uint8_t* moves = ucbs[root_].board.validMoves(s, nMoves);
 	assert(nMoves > 0);
 
-	ucbs[0].board = b;
-	ucbs[0].whosTurn = s;
+	auto iterate = [&]() {
+		montecarlo(t, root_, baseGames_);
+
+		if(t.outOfNodes) {
+			uint32_t freed = collect(t, t.used, root_, t.freeList);
+			std::cerr << "collected " << freed << std::endl;
+
+			t.canCollect = freed > 0;
+			t.outOfNodes = false;
+		}
+	};
 
-	uint32_t cur = 0;
-	auto lalloc = [&]() { return (cur + 1 < len) ? ++cur : ~0u; };
-	std::function<uint32_t()> alloc = lalloc;
+	auto stopped = [&]() {
+		return stop_ && stop_->load(std::memory_order_relaxed);
+	};
 
-	leaves = 0;
 	if(useIterations_) {
-		for(size_t i = 0; i < iterations_; i++) {
-			montecarlo(ucbs.get(), 0, baseGames_, alloc);
+		for(size_t i = 0; i < iterations_ && !ucbs[root_].proven && !stopped(); i++) {
+			iterate();
 		}
 	} else {
 		auto deadline = high_resolution_clock::now() + duration<double>(timePerMove_);
+		bool extended = false;
 
 		auto t1 = high_resolution_clock::now();
-		montecarlo(ucbs.get(), 0, baseGames_, alloc);
+		iterate();
 		auto t2 = high_resolution_clock::now();
 
-		size_t itsCompleted = ucbs[0].plays / 2 / baseGames_;
+		size_t itsCompleted = 1;
+
+		// With a single move there is nothing to decide, it only needs a score.
+		// A fresh root's first iteration plays out from the root itself, the
+		// second one expands the move.
+		for(size_t i = 0; nMoves == 1 && i < 2 && ucbs[root_].childIdxs[0] == NO_NODE && !ucbs[root_].proven; i++) {
+			iterate();
+		}
 
-		while(t2 < deadline) {
+		while((nMoves > 1 || !manageTime_) && !ucbs[root_].proven && !stopped()) {
 			double itsPerSec = itsCompleted / duration_cast<duration<double>>(t2 - t1).count();
-			itsCompleted = std::max(size_t(1), size_t(itsPerSec * duration_cast<duration<double>>(deadline - t2).count()));
+			double left = duration_cast<duration<double>>(deadline - t2).count();
+
+			uint32_t first, second;
+			topTwo(t, root_, nMoves, s, first, second);
+
+			if(left <= 0) {
+				// Give a close race a bit longer, once
+				if(!manageTime_ || extended || second < CLOSE_RACE * first) break;
+
+				deadline += duration_cast<high_resolution_clock::duration>(duration<double>(EXTENSION * timePerMove_));
+				extended = true;
+				continue;
+			}
+
+			// Even if the runner up got every simulation we have time for it
+			// wouldn't catch up with the most played move
+			if(manageTime_ && first - second > itsPerSec * left * 2 * baseGames_) {
+				std::cerr << "stopped with " << left << "s left" << std::endl;
+				break;
+			}
+
+			itsCompleted = std::max(size_t(1), size_t(itsPerSec * std::min(left, CHECK_INTERVAL)));
 
 			t1 = high_resolution_clock::now();
-			for(size_t i = 0; i < itsCompleted; i++) {
-				montecarlo(ucbs.get(), 0, baseGames_, alloc);
+			for(size_t i = 0; i < itsCompleted && !ucbs[root_].proven && !stopped(); i++) {
+				iterate();
 			}
 			t2 = high_resolution_clock::now();
 		}
 	}
 
-	size_t total = 0;
-	for(size_t i = 0; i < len; i++) {
-		if(ucbs[i].plays == 0) total++;
-	}
+	nodesUsed_ = t.used;
+	freeList_ = t.freeList;
+
 	std::cerr << "len " << len << std::endl;
-	std::cerr << "total " << total << std::endl;
-	std::cerr << "maxidx " << cur << std::endl;
-	std::cerr << "simulations " << leaves << std::endl;
+	std::cerr << "used " << nodesUsed_ << std::endl;
+	std::cerr << "simulations " << t.simulations << std::endl;
+	if(ucbs[root_].proven) std::cerr << "proven " << int(ucbs[root_].proven) << std::endl;
+
+	// A proven win beats everything, after that the most played move that isn't
+	// a proven loss. A proven draw is taken over anything that looks worse.
+	const Proof win = winFor(s);
+	const Proof loss = winFor(opposite(s));
 
 	size_t bestMove = moves[0];
 	double bestScore = -std::numeric_limits<double>::infinity();
 	size_t mostPlays = 0;
+	bool haveDraw = false;
+	size_t drawMove = 0;
 
 	for(size_t i = 0; i < nMoves; i++) {
-		size_t idx = ucbs[0].childIdxs[i];
-		double score = ucbs[idx].wins[(int)s] / (double) ucbs[idx].plays;
-		size_t plays = ucbs[idx].plays;
+		uint32_t idx = ucbs[root_].childIdxs[i];
+		if(idx == NO_NODE) continue;
+
+		const UCB& child = ucbs[idx];
+		if(child.proven == win) {
+			return std::make_pair(moves[i], 1.0);
+		}
+
+		if(child.proven == DRAWN) {
+			haveDraw = true;
+			drawMove = moves[i];
+			continue;
+		}
+
+		double score = child.wins[(int)s] / (double) child.plays;
+		size_t tried = t.edges ? t.edges[root_].plays[i] : child.plays;
+		size_t plays = child.proven == loss ? 0 : tried;
 
-		if(plays > mostPlays) {
+		if(plays > mostPlays || bestScore == -std::numeric_limits<double>::infinity()) {
 			mostPlays = plays;
-			bestScore = score;
+			bestScore = child.proven == loss ? 0.0 : score;
 			bestMove = moves[i];
 		}
 	}
 
+	if(haveDraw && bestScore < 0.5) {
+		return std::make_pair(drawMove, 0.5);
+	}
+
+	// The search never got below the root, its own value is all there is
+	if(bestScore == -std::numeric_limits<double>::infinity()) {
+		const UCB& r = ucbs[root_];
+		bestScore = r.proven ? (r.proven == win ? 1.0 : r.proven == DRAWN ? 0.5 : 0.0)
+		          : r.plays ? r.wins[(int)s] / (double) r.plays : 0.5;
+	}
+
 	return std::make_pair(bestMove, bestScore);
 }
 
-// This is hacky, but will do for now
-static thread_local Game g(new RandomAgent, new RandomAgent);
+/// Counts a known result like 2 * baseGames playouts would have
+static std::tuple<uint32_t, uint32_t> settle(UCB& cur, uint8_t proof, size_t baseGames) {
+	cur.proven = proof;
+
+	uint32_t res[2] = {
+		proof == SOUTH_WINS ? uint32_t(2 * baseGames) : proof == DRAWN ? uint32_t(baseGames) : 0u,
+		proof == NORTH_WINS ? uint32_t(2 * baseGames) : proof == DRAWN ? uint32_t(baseGames) : 0u,
+	};
+
+	cur.plays += 2 * baseGames;
+	cur.wins[0] += res[0];
+	cur.wins[1] += res[1];
 
-static std::tuple<uint32_t, uint32_t> randomPlayouts(const Board& b, Side toMove, size_t games) {
+	return std::make_tuple(res[0], res[1]);
+}
+
+/// MCTS-Solver rules: a node is won if any child is won for the side to move,
+/// and lost (or drawn) once every child is proven and none of them is a win.
+static void updateProof(const UCB* ucbs, UCB& cur, size_t nMoves) {
+	const Proof win = winFor(Side(cur.whosTurn));
+	bool allProven = true;
+	bool anyDraw = false;
+
+	for(size_t i = 0; i < nMoves; i++) {
+		uint32_t c = cur.childIdxs[i];
+		uint8_t proof = c == NO_NODE ? uint8_t(UNPROVEN) : ucbs[c].proven;
+
+		if(proof == win) {
+			cur.proven = win;
+			return;
+		}
+
+		allProven &= proof != UNPROVEN;
+		anyDraw |= proof == DRAWN;
+	}
+
+	if(allProven) cur.proven = anyDraw ? DRAWN : winFor(opposite(Side(cur.whosTurn)));
+}
+
+/// Scores a leaf without playing the game out. jimmy_heuristic goes through a
+/// sigmoid to give p, the chance that the side to move wins, and every game
+/// then counts 2p rounded up or down at random. The expected score is exactly
+/// 2p per game while wins stay whole numbers.
+static std::tuple<uint32_t, uint32_t> evaluate(const Tree& t, const Board& b, Side toMove, size_t games) {
+	playout::Rng& rng = playout::threadRng();
 	uint32_t wins[2] = { 0 };
 
+	double p = 1.0 / (1.0 + std::exp(-t.evalScale * jimmy_heuristic(b, toMove)));
+
 	for(size_t i = 0; i < games; i++) {
-		g.board() = b;
-		g.movesPlayed() = 3; // to avoid switching
-		g.toMove() = toMove;
+		Side s = toMove;
 
-		while(g.board().stonesInWell(SOUTH) <= 49 && g.board().stonesInWell(NORTH) <= 49 && !g.isOver()) g.stepTurn();
+		if(t.leafMode == MCAgent::TRUNCATED) {
+			playout::Pits pits(b);
 
-		if(g.board().stonesInWell(SOUTH) > 49) {
-			wins[0] += 2;
-		} else if(g.board().stonesInWell(NORTH) > 49) {
-			wins[1] += 2;
-		} else {
-			uint8_t scores[2] = { g.board().stonesInWell(SOUTH), g.board().stonesInWell(NORTH) };
-			scores[int(g.toMove())^1] += 98 - scores[0] - scores[1];
-
-			int diff = int(scores[0]) - scores[1];
-			if(diff > 0) wins[0] += 2;
-			if(diff < 0) wins[1] += 2;
-			if(diff == 0) {
-				wins[0]++;
-				wins[1]++;
+			if(!playout::advance(pits, s, t.rolloutPlies, rng)) {
+				playout::Result r = playout::outcome(pits, s);
+				wins[SOUTH] += r == playout::SOUTH_WON ? 2 : r == playout::DRAW ? 1 : 0;
+				wins[NORTH] += r == playout::NORTH_WON ? 2 : r == playout::DRAW ? 1 : 0;
+				continue;
 			}
+
+			p = 1.0 / (1.0 + std::exp(-t.evalScale * jimmy_heuristic(pits.toBoard(), s)));
 		}
-	}
 
-	return std::make_tuple(wins[0], wins[1]);
+		uint32_t score = uint32_t(2.0 * p + (rng.next() >> 11) / double(1ull << 53));
+		wins[s] += score;
+		wins[opposite(s)] += 2 - score;
+	}
 
+	return std::make_tuple(wins[SOUTH], wins[NORTH]);
 }
 
-// South score, north score
-static std::tuple<uint32_t, uint32_t> montecarlo(UCB* ucbs, size_t idx, size_t baseGames, std::function<uint32_t()>& alloc) {
-	UCB& cur = ucbs[idx];
-	const Side toMove = cur.whosTurn;
-	const Side opp = opposite(toMove);
+/// The node for a child position, the one already in the graph if
+/// transpositions are shared. NO_NODE if there is no room for a new one.
+static uint32_t childFor(Tree& t, const Board& board, Side next) {
+	uint32_t idx = t.index ? lookup(t, board, next) : NO_NODE;
+	if(idx != NO_NODE) return idx;
+
+	idx = alloc(t);
+	if(idx != NO_NODE) {
+		t.ucbs[idx].board = board;
+		t.ucbs[idx].whosTurn = next;
+		if(t.index) insert(t, idx);
+		if(t.bookPrior) addBookPrior(t, t.ucbs[idx]);
+	}
 
-	// Guaranteed win/loss ;)
-	if(cur.board.stonesInWell(SOUTH) > 49) {
-		cur.plays += 2 * baseGames;
-		cur.wins[0] += 2 * baseGames;
+	return idx;
+}
 
-		return std::make_tuple(uint32_t(2 * baseGames), uint32_t(0));
-	}
+// The alpha-beta move ordering caches are dropped once they get this big
+static const size_t MM_CACHE_LIMIT = 1 << 20;
 
-	if(cur.board.stonesInWell(NORTH) > 49) {
-		cur.plays += 2 * baseGames;
-		cur.wins[1] += 2 * baseGames;
+/// Alpha-beta from a node, for the short tactics a few random games easily
+/// miss. Returns the proof if the result is forced, otherwise adds the
+/// evaluation to the node as hybridPrior plays. A win is only taken along
+/// with the child it plays, proven too, so the node can name its move if it
+/// becomes the root.
+static uint8_t shallowSearch(Tree& t, UCB& cur) {
+	const Side toMove = Side(cur.whosTurn);
+	cur.searched = 1;
 
-		return std::make_tuple(uint32_t(0), uint32_t(2 * baseGames));
+	if(t.mmCache->size() > MM_CACHE_LIMIT) {
+		t.mmCache->clear();
 	}
 
+	auto res = MiniMaxAgent::alphaBeta(cur.board, toMove, t.hybridDepth, *t.mmCache);
+	double val = res.second;
 
-	size_t nMoves;
-	const auto* moves = cur.board.validMoves(toMove, nMoves);
+	const uint8_t proof = val == std::numeric_limits<double>::infinity() ? SOUTH_WINS :
+	                      val == -std::numeric_limits<double>::infinity() ? NORTH_WINS :
+	                                                                         UNPROVEN;
 
-	// The game is over
-	if(nMoves == 0) {
-		//determine who won and update accordingly
-		uint8_t scores[2] = { cur.board.stonesInWell(SOUTH), cur.board.stonesInWell(NORTH) };
-		scores[opp] += 98 - scores[0] - scores[1];
+	// A loss is lost whatever gets played
+	if(proof && proof != winFor(toMove)) return proof;
 
-		cur.plays+= 2 * baseGames;
+	if(proof) {
+		size_t nMoves;
+		const uint8_t* moves = cur.board.validMoves(toMove, nMoves);
 
-		if(scores[0] > scores[1]) {
-			cur.wins[0] += 2 * baseGames;
-			return std::make_tuple((uint32_t)2 * baseGames, 0u);
-		}
+		for(size_t i = 0; i < nMoves; i++) {
+			if(moves[i] != res.first) continue;
 
-		if(scores[0] < scores[1]) {
-			cur.wins[1] +=  2 * baseGames;
-			return std::make_tuple(0u, (uint32_t)2 * baseGames);
+			if(cur.childIdxs[i] == NO_NODE) {
+				Board board = cur.board;
+				bool ga = board.makeMove(toMove, moves[i]);
+				cur.childIdxs[i] = childFor(t, board, ga ? toMove : opposite(toMove));
+			}
+			if(cur.childIdxs[i] != NO_NODE) {
+				t.ucbs[cur.childIdxs[i]].proven = proof;
+				return proof;
+			}
 		}
 
-		cur.wins[0] += baseGames;
-		cur.wins[1] += baseGames;
+		// No room for the child, the win only counts as a prior
+	}
+
+	double p = 1.0 / (1.0 + std::exp(-t.evalScale * val));
+	uint32_t south = uint32_t(p * t.hybridPrior + 0.5);
+
+	cur.plays += t.hybridPrior;
+	cur.wins[SOUTH] += south;
+	cur.wins[NORTH] += t.hybridPrior - south;
+
+	return UNPROVEN;
+}
+
+/// A new node the book has a value for starts with bookPrior plays of it
+static void addBookPrior(const Tree& t, UCB& cur) {
+	const Side toMove = Side(cur.whosTurn);
 
-		return std::make_tuple((uint32_t)baseGames, (uint32_t)baseGames);
+	float v = books::value(toMove, cur.board);
+	if(v < 0.0f) return;
+
+	uint32_t won = uint32_t(v * t.bookPrior + 0.5f);
+	cur.plays += t.bookPrior;
+	cur.wins[toMove] += won;
+	cur.wins[opposite(toMove)] += t.bookPrior - won;
+}
+
+static inline void addAmaf(AmafStats& amaf, const playout::MoveCounts& counts, Side s) {
+	for(size_t i = 0; i < 7; i++) {
+		amaf.plays[i] += counts.plays[s][i];
+		amaf.wins[i] += counts.wins[s][i];
 	}
+}
 
-	// Selection + backpropagation
-	if(cur.plays > 0 && cur.childIdxs[0] != ~0u) {
-		size_t total = 0;
-		size_t childI = 8;
-		bool abandonShip = false;
+/// One iteration: walk down from the root picking children by UCB, expanding
+/// the first missing one on the way, then play out from the leaf and add the
+/// result to every node on the path
+static void montecarlo(Tree& t, uint32_t root, size_t baseGames) {
+	UCB* ucbs = t.ucbs;
+
+	// Known results and playouts both count as 2 * baseGames plays
+	const uint32_t delta = uint32_t(2 * baseGames);
+	uint32_t res[2];
+
+	// Moves seen from the current node down, only kept with RAVE
+	playout::MoveCounts counts;
+	if(t.amaf) memset(&counts, 0, sizeof(counts));
+
+	uint32_t idx = root;
+	t.path.clear();
+
+	// Selection + expansion
+	while(true) {
+		UCB& cur = ucbs[idx];
+		const Side toMove = Side(cur.whosTurn);
+		const Side opp = opposite(toMove);
+
+		size_t nMoves = 0;
+		const uint8_t* moves = nullptr;
+		uint8_t proof = cur.proven;
+
+		// Guaranteed win/loss ;)
+		if(proof) {
+			// Nothing left to find out here
+		} else if(cur.board.stonesInWell(SOUTH) > 49) {
+			proof = SOUTH_WINS;
+		} else if(cur.board.stonesInWell(NORTH) > 49) {
+			proof = NORTH_WINS;
+		} else {
+			moves = cur.board.validMoves(toMove, nMoves);
+
+			// The game is over
+			if(nMoves == 0) {
+				//determine who won and update accordingly
+				uint8_t scores[2] = { cur.board.stonesInWell(SOUTH), cur.board.stonesInWell(NORTH) };
+				scores[opp] += 98 - scores[0] - scores[1];
+
+				proof = scores[0] > scores[1] ? SOUTH_WINS :
+				        scores[0] < scores[1] ? NORTH_WINS :
+				                                DRAWN;
+			} else {
+				// Proofs only travel up the path they were found on. A shared
+				// child proven through another parent is picked up here.
+				if(t.edges && cur.plays > 0) {
+					updateProof(ucbs, cur, nMoves);
+					proof = cur.proven;
+				}
 
-		for(size_t i = 0; i < nMoves; i++) {
-			if(cur.childIdxs[i] == 0) {
-				cur.childIdxs[i] = alloc();
-				if(cur.childIdxs[i] == ~0u) {
-					abandonShip = true;
-					cur.childIdxs[0] = ~0u;
-				} else {
-					childI = cur.childIdxs[i];
-					UCB& child = ucbs[cur.childIdxs[i]];
-
-					child.board = cur.board;
-					bool ga = child.board.makeMove(cur.whosTurn, moves[i]);
-
-					child.whosTurn = ga ? toMove : opp;
+				if(!proof && t.hybridDepth && !cur.searched && cur.plays >= t.hybridVisits && idx != root) {
+					// The root needs a move and not just a value, it gets proven through its children
+					proof = shallowSearch(t, cur);
 				}
-				break;
 			}
-			total += ucbs[cur.childIdxs[i]].plays;
 		}
 
+		if(proof) {
+			std::tie(res[0], res[1]) = settle(cur, proof, baseGames);
+			break;
+		}
+
+		uint32_t childI = NO_NODE;
+		size_t moveIdx = 0;
+
+		if(cur.plays > 0) {
+			bool expanded = false;
+
+			// Expand the first child we haven't looked at yet, or link to the
+			// node we already have if the position was reached some other way.
+			// If there is no room left this ends in a playout from cur.
+			for(size_t i = 0; i < nMoves; i++) {
+				if(cur.childIdxs[i] != NO_NODE) continue;
 
-		if(!abandonShip) {
-			if(childI > 6) {
-				double logTotal = 3.0 * log(cur.plays);
-				double max = -std::numeric_limits<double>::infinity();
-				size_t moveIdx = 0;
+				Board board = cur.board;
+				bool ga = board.makeMove(toMove, moves[i]);
+
+				childI = childFor(t, board, ga ? toMove : opp);
+				if(childI != NO_NODE) cur.childIdxs[i] = childI;
+				moveIdx = i;
+				expanded = true;
+				break;
+			}
+
+			if(!expanded) {
+				// Single precision is plenty to rank at most 7 children
+				const float logTotal = 3.0f * logOf(cur.plays);
+				float max = -std::numeric_limits<float>::infinity();
 
 				for(size_t i = 0; i < nMoves; i++) {
-					UCB& child = ucbs[cur.childIdxs[i]];
+					const UCB& child = ucbs[cur.childIdxs[i]];
+
+					// Proven children can't teach us anything new. If they
+					// all are, cur gets proven on the way back up.
+					if(child.proven) continue;
 
-					if(child.plays == 0) {
+					// The value is shared by every parent, exploration is
+					// down to how often this parent tried the move
+					uint32_t tried = t.edges ? t.edges[idx].plays[i] : child.plays;
+					if(tried == 0) {
 						moveIdx = i;
 						break;
 					}
 
-					double bound = child.wins[(int)toMove] / (float) child.plays;
-					bound += sqrt(logTotal / child.plays);
+					float bound = child.wins[(int)toMove] / (float) child.plays;
+
+					if(t.amaf) {
+						const AmafStats& amaf = t.amaf[idx];
+						const uint8_t hole = moves[i];
+
+						if(amaf.plays[hole] > 0) {
+							float beta = std::sqrt(t.raveK / (3.0f * tried + t.raveK));
+							bound += beta * (amaf.wins[hole] / (float) amaf.plays[hole] - bound);
+						}
+					}
+
+					bound += std::sqrt(logTotal / tried);
 
 					if(bound > max) {
 						max = bound;
@@ -275,24 +1033,61 @@ static std::tuple<uint32_t, uint32_t> montecarlo(UCB* ucbs, size_t idx, size_t b
 
 				childI = cur.childIdxs[moveIdx];
 			}
+		}
 
-			uint32_t curPlays = ucbs[childI].plays;
-			auto res = montecarlo(ucbs, childI, baseGames, alloc);
+		if(childI == NO_NODE) {
+			// Random playouts
+			// The batched playouts don't keep track of moves, RAVE plays them one by one
+			t.simulations++;
+			if(t.leafMode != MCAgent::ROLLOUT) {
+				std::tie(res[0], res[1]) = evaluate(t, cur.board, toMove, baseGames);
+			} else if(t.amaf) {
+				std::tie(res[0], res[1]) = playout::randomPlayouts(cur.board, toMove, baseGames, counts);
+			} else {
+				std::tie(res[0], res[1]) = baseGames >= playout::BATCH_MIN_GAMES ? playout::batchPlayouts(cur.board, toMove, baseGames)
+				                                                                 : playout::randomPlayouts(cur.board, toMove, baseGames);
+			}
+			cur.plays += delta;
+			cur.wins[0] += res[0];
+			cur.wins[1] += res[1];
+			break;
+		}
 
-			cur.plays += ucbs[childI].plays - curPlays;
-			cur.wins[0] += std::get<0>(res);
-			cur.wins[1] += std::get<1>(res);
+		t.path.emplace_back(idx, uint8_t(moveIdx));
+		idx = childI;
+	}
 
-			return res;
+	// Backpropagation
+	if(t.amaf) addAmaf(t.amaf[idx], counts, Side(ucbs[idx].whosTurn));
+
+	uint32_t child = idx;
+	for(size_t i = t.path.size(); i-- > 0;) {
+		const uint32_t parent = t.path[i].first;
+		const size_t moveIdx = t.path[i].second;
+		UCB& cur = ucbs[parent];
+
+		cur.plays += delta;
+		cur.wins[0] += res[0];
+		cur.wins[1] += res[1];
+		if(t.edges) t.edges[parent].plays[moveIdx] += delta;
+
+		// The move made here came up in every game of this simulation
+		if(t.amaf) {
+			const Side mover = Side(cur.whosTurn);
+			size_t nMoves;
+			const uint8_t hole = cur.board.validMoves(mover, nMoves)[moveIdx];
+
+			counts.plays[mover][hole] = delta;
+			counts.wins[mover][hole] = res[mover];
+			addAmaf(t.amaf[parent], counts, mover);
 		}
-	}
 
-	// Random playouts
-	leaves++;
-	auto res = randomPlayouts(cur.board, cur.whosTurn, baseGames);
-	cur.plays += 2 * baseGames;
-	cur.wins[0] += std::get<0>(res);
-	cur.wins[1] += std::get<1>(res);
+		if(ucbs[child].proven) {
+			size_t nMoves;
+			cur.board.validMoves(Side(cur.whosTurn), nMoves);
+			updateProof(ucbs, cur, nMoves);
+		}
 
-	return res;
+		child = parent;
+	}
 }
@@ -1,23 +1,75 @@
 #pragma once
 
+#include <atomic>
 #include <utility>
 
 #include "Agent.hpp"
+#include "Arena.hpp"
+#include "MiniMaxAgent.hpp"
 
 class MCAgent : public Agent {
 public:
+	static const uint8_t NO_MOVE = 0xff;
+
 	MCAgent(uint32_t bufSize, uint16_t ucbBaseGames, uint32_t iterations);
 	MCAgent() : MCAgent(500000, 1, 100000) {}
 
 	std::pair<uint8_t, float> makeMoveAndScore(const Board& board, Side side, size_t movesSoFar, uint8_t lastMove);
 	uint8_t makeMove(const Board& board, Side side, size_t movesSoFar, uint8_t lastMove) override;
 
+	/// Whether the tree kept from the last search contains this position
+	bool hasTreeFor(const Board& board, Side side);
+	/// The move the kept tree has played most in this position, or NO_MOVE
+	/// if it doesn't have the position or hasn't expanded it
+	uint8_t mostPlayed(const Board& board, Side side);
+
 	uint32_t& bufferSize();
+
+	/// What each node of bufferSize costs with the current settings, the
+	/// statistics and index that come with it included
+	size_t bytesPerNode() const;
 	uint16_t& baseGames();
 	uint32_t& iterations();
 
 	float& timePerMove();
 	bool& useIterations();
+	/// A timed search stops early once the most played move can't be caught
+	/// and gives a close race a little longer. Off, it searches for all of
+	/// timePerMove, for when the score matters and the move doesn't.
+	bool& manageTime();
+
+	/// Share one node between every move order that reaches a position
+	bool& useTranspositions();
+
+	/// Blend all-moves-as-first statistics into the UCB values. The weight
+	/// of the AMAF value is sqrt(k / (3n + k)) after n plays of a move, with k
+	/// given by raveEquivalence.
+	bool& useRave();
+	float& raveEquivalence();
+
+	/// How leaves get scored: a random game to the end, jimmy_heuristic
+	/// straight away, or rolloutPlies random moves and then jimmy_heuristic.
+	/// Evaluations become win probabilities through a sigmoid with slope evalScale.
+	enum LeafMode : uint8_t { ROLLOUT, EVALUATE, TRUNCATED };
+	LeafMode& leafMode();
+	uint32_t& rolloutPlies();
+	float& evalScale();
+
+	/// Hybrid search: every node that reaches hybridVisits plays gets a
+	/// hybridDepth ply alpha-beta. A forced result within that horizon proves
+	/// the node, anything else is added to it as hybridPrior plays of the
+	/// evaluation (through the evalScale sigmoid). A depth of 0 turns it off.
+	uint8_t& hybridDepth();
+	uint32_t& hybridVisits();
+	uint32_t& hybridPrior();
+
+	/// Nodes whose position the opening book has a value for start out with
+	/// bookPrior plays of that value. 0 turns it off.
+	uint32_t& bookPrior();
+
+	/// Checked between iterations, once it is set the search returns with
+	/// whatever it has found so far
+	const std::atomic<bool>*& stop();
 
 private:
 	uint32_t bufSize_;
@@ -26,4 +78,36 @@ private:
 
 	float timePerMove_;
 	bool useIterations_;
+	bool manageTime_;
+	bool useTranspositions_;
+	bool useRave_;
+	float raveEquivalence_;
+	LeafMode leafMode_;
+	uint32_t rolloutPlies_;
+	float evalScale_;
+	uint8_t hybridDepth_;
+	uint32_t hybridVisits_;
+	uint32_t hybridPrior_;
+	uint32_t bookPrior_;
+
+	const std::atomic<bool>* stop_;
+
+	// Move ordering cache for the hybrid alpha-beta
+	MiniMaxAgent::MoveCache mmCache_;
+
+	// Node storage, mapped once and reused by every search
+	Arena nodes_;
+	// Per move visits and the position index, only used with transpositions
+	Arena edges_;
+	Arena index_;
+	// AMAF statistics, only used with RAVE
+	Arena amaf_;
+	uint32_t nodesUsed_;
+	uint32_t root_;
+	uint32_t freeList_;
+	bool treeIsDag_;
+	bool treeHasRave_;
+
+	/// Whether the kept tree was built with the current settings
+	bool treeFits() const;
 };
@@ -1,5 +1,9 @@
 #include "MiniMaxAgent.hpp"
 
+#include "heuristics.hpp"
+#include "Book.hpp"
+#include "books.hpp"
+
 #include <utility>
 #include <stdlib.h>
 #include <iostream>
@@ -8,11 +12,22 @@
 #include <vector>
 #include <algorithm>
 #include <chrono>
+#include <limits>
 
 static std::pair<uint8_t,double> minimax_alphabeta(uint8_t depth, Side s, Board& b, size_t movesSoFar, double alpha, double beta,
-													MiniMaxAgent::MoveCache& cache_north, MiniMaxAgent::MoveCache& cache_south);
+													MiniMaxAgent::MoveCache& cache, size_t cacheLimit, const std::atomic<bool>* stop);
 std::pair<uint8_t,double> iterative_deepening(Side toMove, const Board& b, size_t movesSoFar, double time);
 
+// A node of std::unordered_map: the entry, the link to the next node, the
+// cached hash, its bucket and what malloc keeps next to it
+static const size_t CACHE_ENTRY_BYTES = sizeof(MiniMaxAgent::MoveCache::value_type) + 4 * sizeof(void*);
+
+MiniMaxAgent::MiniMaxAgent() : cacheBytes_(std::numeric_limits<size_t>::max()) {}
+
+size_t& MiniMaxAgent::cacheBudget() {
+	return cacheBytes_;
+}
+
 uint8_t MiniMaxAgent::makeMove(const Board& b, Side s, size_t movesSoFar, uint8_t lastMove) {
 	// Swap Logic
 	if(movesSoFar == 0) return 1;
@@ -40,18 +55,30 @@ static inline bool pairCompare_minimize(const std::pair<uint8_t, double>& firstE
   return firstElem.second < secondElem.second;
 }
 
-static inline void cacheIt(const Board& b, double val, Side s, MiniMaxAgent::MoveCache& cache_north, MiniMaxAgent::MoveCache& cache_south){
-	Board bCopy = b;		                             
-	if(s == SOUTH)
-		cache_south.insert(std::make_pair(bCopy, val));
-	if(s == NORTH)
-		cache_north.insert(std::make_pair(bCopy, val));
+// Entries are keyed by the canonical board and hold the value for the side
+// to move, so a position and its mirror image share one
+static inline void cacheIt(const Board& b, double val, Side s, MiniMaxAgent::MoveCache& cache, size_t cacheLimit){
+	// Full, whatever is in there keeps ordering moves
+	if(cache.size() >= cacheLimit) return;
+
+	cache.insert(std::make_pair(canonical(b, s), s == SOUTH ? val : -val));
+}
+
+/// The value for south of b with s to move, if it is cached
+static inline bool findCached(const Board& b, Side s, const MiniMaxAgent::MoveCache& cache, double& val){
+	auto it = cache.find(canonical(b, s));
+	if(it == cache.end()) return false;
+
+	val = s == SOUTH ? it->second : -it->second;
+	return true;
 }
 
 std::pair<uint8_t,double> MiniMaxAgent::iterative_deepening(Side toMove, const Board& b,
-																size_t movesSoFar, double time, std::function<void(uint8_t, double)> up){
-	MiniMaxAgent::MoveCache cache_north = {};
-	MiniMaxAgent::MoveCache cache_south = {};
+																size_t movesSoFar, double time, std::function<void(uint8_t, double)> up,
+																const std::atomic<bool>* stop){
+	MiniMaxAgent::MoveCache cache = {};
+
+	const size_t cacheLimit = cacheBytes_ / CACHE_ENTRY_BYTES;
 
 	uint8_t CURRENT_DEPTH = 6;
 	std::pair<uint8_t,double> final_result = std::make_pair(8, toMove == SOUTH? -1.0/0.0 : 1.0/0.0);
@@ -61,8 +88,12 @@ std::pair<uint8_t,double> MiniMaxAgent::iterative_deepening(Side toMove, const B
 	
 	while(current < deadline){
 		Board bCopy = b;
-		final_result = minimax_alphabeta(CURRENT_DEPTH, toMove, bCopy, movesSoFar, -1.0/0.0, 1.0/0.0, cache_north, cache_south);
-		
+		auto result = minimax_alphabeta(CURRENT_DEPTH, toMove, bCopy, movesSoFar, -1.0/0.0, 1.0/0.0, cache, cacheLimit, stop);
+
+		// Cut short, the result is meaningless
+		if(stop && stop->load(std::memory_order_relaxed)) break;
+
+		final_result = result;
 		up(final_result.first, final_result.second);
 
 		CURRENT_DEPTH++;
@@ -73,70 +104,36 @@ std::pair<uint8_t,double> MiniMaxAgent::iterative_deepening(Side toMove, const B
 	return final_result;
 }
 
-/// Returns the heuristic value for south. 0 indicates a draw, positive values an advantage for south, and negative values and advantage for north.
-static inline double heuristic(const Board& b) {
-	return double(b.stonesInWell(SOUTH)) - b.stonesInWell(NORTH);
-}
-
-static inline bool isSeedable(const Board& b, Side s, uint8_t idx) {
-	bool toRet = false;
-	int8_t cur = idx - 1;
-
-	do {
-		if(cur < 0) break;
-		if(idx - cur == b.stonesInHole(s, cur)) {
-			toRet = true;
-			break;
-		}
-		cur--;
-	} while(true);
-
-	return toRet;
+std::pair<uint8_t,double> MiniMaxAgent::alphaBeta(const Board& b, Side toMove, uint8_t depth,
+												   MoveCache& cache) {
+	Board bCopy = b;
+	return minimax_alphabeta(depth, toMove, bCopy, 0, -1.0/0.0, 1.0/0.0, cache, std::numeric_limits<size_t>::max(), nullptr);
 }
 
-static inline double jimmy_heuristic(const Board& b, Side s) {
-	Side o = Side(int(s)^1);
-	double d = 0.0;
-
-	double ourWell = b.stonesInWell(s);
-	double oppWell = b.stonesInWell(o);
-	if((ourWell != 0.0 || oppWell != 0.0) && ourWell != oppWell) {
-		double bigWell;
-		double smallWell;
-		if(ourWell > oppWell) {
-			bigWell = ourWell;
-			smallWell = oppWell;
-		} else {
-			bigWell = oppWell;
-			smallWell = ourWell;
-		}
-		d = ((1.0 / bigWell) * (bigWell - smallWell) + 1.0) * bigWell;
-		if(oppWell > ourWell) d *= -1;
-	}
-
-	size_t N;
-	const auto* moves = b.validMoves(s, N);
-
-	int ourSum = 0;
-	for(size_t i = 0; i < N; i++) {
-		ourSum += b.stonesInHole(s, moves[i]);
-	}
-
-	int oppSum = 98 - ourWell - oppWell - ourSum;
+/// Moves the book's move for this position to the front, if it has one
+static inline void bookFirst(const Board& b, Side s, std::pair<uint8_t, double>* moves, size_t nMoves) {
+	uint8_t book = books::find(s, b);
+	if(book == Book::NO_MOVE) return;
 
-	d += (ourSum - oppSum) / 2.0;
-
-	for(uint8_t i = 0; i < 7; i++) {
-		if(b.stonesInHole(o, i) == 0 && isSeedable(b, o, i)) {
-			d -= b.stonesInHole(s, 6-i);
+	for(size_t i = 0; i < nMoves; i++) {
+		if(moves[i].first == book) {
+			std::rotate(moves, moves + i, moves + i + 1);
+			return;
 		}
 	}
+}
 
-	return d;
+/// Returns the heuristic value for south. 0 indicates a draw, positive values an advantage for south, and negative values and advantage for north.
+static inline double heuristic(const Board& b) {
+	return double(b.stonesInWell(SOUTH)) - b.stonesInWell(NORTH);
 }
 
 static std::pair<uint8_t,double> minimax_alphabeta(uint8_t depth, const Side toMove, Board& b, size_t movesSoFar, double alpha,	
-													double beta, MiniMaxAgent::MoveCache& cache_north, MiniMaxAgent::MoveCache& cache_south){
+													double beta, MiniMaxAgent::MoveCache& cache, size_t cacheLimit,
+													const std::atomic<bool>* stop){
+	// Unwind as fast as possible, the caller ignores whatever comes back
+	if(stop && stop->load(std::memory_order_relaxed)) return std::make_pair(0, 0.0);
+
 	size_t nMoves;
 	auto* moves = b.validMoves(toMove, nMoves);
 
@@ -150,17 +147,17 @@ static std::pair<uint8_t,double> minimax_alphabeta(uint8_t depth, const Side toM
 		double val = scoreDiff > 0 ?  1.0/0.0 :
 		             scoreDiff < 0 ? -1.0/0.0 :
 		                             0.0;
-		cacheIt(b, val, scoreDiff > 0? SOUTH : NORTH, cache_north, cache_south);
+		cacheIt(b, val, scoreDiff > 0? SOUTH : NORTH, cache, cacheLimit);
 		return std::make_pair(0, val);
 	}
 
 	// Someone Can Reach A Certain Win
 	if(b.stonesInWell(SOUTH) > 49){
-		cacheIt(b, 1.0/0.0, SOUTH, cache_north, cache_south);
+		cacheIt(b, 1.0/0.0, SOUTH, cache, cacheLimit);
 		return std::make_pair(moves[0], 1.0/0.0);
 	}
 	else if(b.stonesInWell(NORTH) > 49){
-		cacheIt(b, -1.0/0.0, NORTH, cache_north, cache_south);
+		cacheIt(b, -1.0/0.0, NORTH, cache, cacheLimit);
 		return std::make_pair(moves[0], -1.0/0.0);
 	}
 
@@ -168,7 +165,7 @@ static std::pair<uint8_t,double> minimax_alphabeta(uint8_t depth, const Side toM
 	if(depth == 0){
 		double val = jimmy_heuristic(b, toMove);
 		if(toMove != SOUTH) val *= -1;
-		cacheIt(b, val, toMove, cache_north, cache_south);
+		cacheIt(b, val, toMove, cache, cacheLimit);
 		return std::make_pair(-1, val);
 	}
 
@@ -182,9 +179,7 @@ static std::pair<uint8_t,double> minimax_alphabeta(uint8_t depth, const Side toM
 		if(depth > 3){
 			// Check All Moves
 			for(uint8_t i = 0; i < nMoves; i++){
-				if(cache_south.find(b) != cache_south.end()){
-					possibleMoves[i].second = cache_south[b];
-				} else{
+				if(!findCached(b, SOUTH, cache, possibleMoves[i].second)){
 					Board nCopy = b;
 					bool ga = nCopy.makeMove(toMove, possibleMoves[i].first);
 					possibleMoves[i].second = jimmy_heuristic(nCopy, ga ? SOUTH : NORTH);
@@ -194,6 +189,7 @@ static std::pair<uint8_t,double> minimax_alphabeta(uint8_t depth, const Side toM
 
 			// Sort based on best payoff
 			std::sort(std::begin(possibleMoves), std::begin(possibleMoves)+nMoves, pairCompare);
+			bookFirst(b, SOUTH, possibleMoves, nMoves);
 		}
 
 		std::pair<uint8_t,double> result = std::make_pair(8, -1.0/0.0);
@@ -203,7 +199,7 @@ static std::pair<uint8_t,double> minimax_alphabeta(uint8_t depth, const Side toM
 			bool goAgain = nCopy.makeMove(toMove, move);
 
 			std::pair<uint8_t,double> nResult = minimax_alphabeta(depth-1, goAgain ? SOUTH : NORTH, nCopy,
-																	 movesSoFar+1, alpha, beta, cache_north, cache_south);
+																	 movesSoFar+1, alpha, beta, cache, cacheLimit, stop);
 			if(nResult.second >= result.second){
 				result = nResult;
 				result.first = move;
@@ -214,7 +210,7 @@ static std::pair<uint8_t,double> minimax_alphabeta(uint8_t depth, const Side toM
 			}
 
 		}
-		cacheIt(b, result.second, SOUTH, cache_north, cache_south);
+		cacheIt(b, result.second, SOUTH, cache, cacheLimit);
 		return result;
 	} 
 	// MINIMIZE
@@ -226,9 +222,7 @@ static std::pair<uint8_t,double> minimax_alphabeta(uint8_t depth, const Side toM
 		if(depth > 3){
 			// Check All Moves
 			for(uint8_t i = 0; i < nMoves; i++){
-				if(cache_north.find(b) != cache_north.end()){
-					possibleMoves[i].second = cache_north[b];
-				} else{
+				if(!findCached(b, NORTH, cache, possibleMoves[i].second)){
 					Board nCopy = b;
 					bool ga = nCopy.makeMove(toMove, possibleMoves[i].first);
 					possibleMoves[i].second = jimmy_heuristic(nCopy, ga ? NORTH : SOUTH);
@@ -238,6 +232,7 @@ static std::pair<uint8_t,double> minimax_alphabeta(uint8_t depth, const Side toM
 
 			// Sort based on best payoff
 			std::sort(std::begin(possibleMoves), std::begin(possibleMoves)+nMoves, pairCompare_minimize);
+			bookFirst(b, NORTH, possibleMoves, nMoves);
 		}
 
 		std::pair<uint8_t,double> result = std::make_pair(8, 1.0/0.0);
@@ -247,7 +242,7 @@ static std::pair<uint8_t,double> minimax_alphabeta(uint8_t depth, const Side toM
 			bool goAgain = nCopy.makeMove(toMove, move);
 
 			std::pair<uint8_t,double> nResult = minimax_alphabeta(depth-1, goAgain ? NORTH : SOUTH, nCopy, 
-																	movesSoFar+1, alpha, beta, cache_north, cache_south);
+																	movesSoFar+1, alpha, beta, cache, cacheLimit, stop);
 			if(nResult.second <= result.second){
 				result = nResult;
 				result.first = move;
@@ -258,7 +253,7 @@ static std::pair<uint8_t,double> minimax_alphabeta(uint8_t depth, const Side toM
 			}
 
 		}
-		cacheIt(b, result.second, NORTH, cache_north, cache_south);
+		cacheIt(b, result.second, NORTH, cache, cacheLimit);
 		return result;
 	}
 }
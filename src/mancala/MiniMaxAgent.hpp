@@ -2,13 +2,33 @@
 
 #include "Agent.hpp"
 
+#include <atomic>
 #include <functional>
 #include <unordered_map>
 
 class MiniMaxAgent : public Agent {
 public:
 	typedef std::unordered_map<Board, double> MoveCache;
+
+	MiniMaxAgent();
+
+	/// Roughly how many bytes the move ordering cache of one search may take.
+	/// Once it is full nothing new is cached and ordering gets worse.
+	/// Unlimited by default.
+	size_t& cacheBudget();
+
 	uint8_t makeMove(const Board& board, Side side, size_t movesSoFar, uint8_t lastMove) override;
+	/// Deepens until time runs out or stop is set, whichever comes first.
+	/// A depth that gets stopped halfway is thrown away.
 	std::pair<uint8_t,double> iterative_deepening(Side toMove, const Board& b, size_t movesSoFar,
-												  double time, std::function<void(uint8_t, double)> up);
+												  double time, std::function<void(uint8_t, double)> up,
+												  const std::atomic<bool>* stop = nullptr);
+
+	/// A single fixed depth search, the value is from south's point of view.
+	/// +/-infinity means one side wins by force within depth plies.
+	static std::pair<uint8_t,double> alphaBeta(const Board& b, Side toMove, uint8_t depth,
+											   MoveCache& cache);
+
+private:
+	size_t cacheBytes_;
 };
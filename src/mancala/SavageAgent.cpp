@@ -2,93 +2,249 @@
 
 #include "MCAgent.hpp"
 #include "MiniMaxAgent.hpp"
+#include "Book.hpp"
 #include "books.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <future>
-#include <thread>
 #include <utility>
 #include <iostream>
 
-static std::pair<uint8_t, float> minimaxCheck(size_t movesSoFar, Board b, Side s, double time, std::function<void(uint8_t, double)> up) {
+const size_t SavageAgent::DEFAULT_MEMORY_BUDGET;
+constexpr double SavageAgent::DEFAULT_GAME_TIME;
+
+static bool forcedWin(Side s, double mmScore) {
+	return s == SOUTH ? mmScore > 200 : mmScore < -200;
+}
+
+static std::pair<uint8_t, float> minimaxCheck(size_t movesSoFar, Board b, Side s, double time, std::function<void(uint8_t, double)> up,
+                                              const std::atomic<bool>* stop, size_t cacheBytes) {
 	MiniMaxAgent mm;
+	mm.cacheBudget() = cacheBytes;
 	
 	if(movesSoFar > 20) {
 		Board bCopy = b;
-		std::pair<uint8_t, double> result = mm.iterative_deepening(s, bCopy, movesSoFar, time, up);
-		if(s == SOUTH && result.second > 200){
-			return std::make_pair(result.first, 1.0/0.0);
-		} else if(s == NORTH && result.second < -200){
+		std::pair<uint8_t, double> result = mm.iterative_deepening(s, bCopy, movesSoFar, time, up, stop);
+		if(forcedWin(s, result.second)) {
 			return std::make_pair(result.first, 1.0/0.0);
 		}
 	}
 	return std::make_pair(0,0.0);
 }
 
-static std::pair<uint8_t, float> monteCarloPar(Board b, Side s, size_t movesSoFar, uint8_t lastMove, double time) {
-	MCAgent mc(50000000, 1, 1);
-	mc.useIterations() = false;
-	mc.timePerMove() = time;
-	
-	return mc.makeMoveAndScore(b, s, movesSoFar, lastMove);
+static std::pair<uint8_t, float> monteCarloPar(MCAgent* mc, Board b, Side s, size_t movesSoFar, uint8_t lastMove, double time) {
+	// The move ended the game, whoever still has stones keeps them
+	size_t nMoves;
+	b.validMoves(s, nMoves);
+	if(nMoves == 0) {
+		int ours = b.stonesInWell(s);
+		int theirs = 98 - ours;
+		return std::make_pair(0, ours > theirs ? 1.0f : ours < theirs ? 0.0f : 0.5f);
+	}
+
+	mc->timePerMove() = time;
+
+	return mc->makeMoveAndScore(b, s, movesSoFar, lastMove);
+}
+
+SavageAgent::SavageAgent(size_t memoryBudget, double gameTime, double increment)
+	: mmCacheBytes_(memoryBudget / 8), clock_(gameTime, increment, 30.0), stop_(false), ponderSide_(SOUTH),
+	  pondered_(0.0), nPonderJobs_(0), pool_(8) {
+	const size_t share = memoryBudget / 8;
+
+	for(auto& mc : mcs_) {
+		mc.reset(new MCAgent(1, 1, 1));
+		mc->useIterations() = false;
+		// Each root is a position after one of our moves, settling the reply
+		// there doesn't settle which of them we pick. Scores need the time.
+		mc->manageTime() = false;
+		mc->stop() = &stop_;
+
+		size_t nodes = share / mc->bytesPerNode();
+		mc->bufferSize() = uint32_t(std::max<size_t>(1, std::min<size_t>(nodes, UINT32_MAX - 1)));
+	}
+}
+
+SavageAgent::~SavageAgent() {
+	// The pool waits for its jobs, a ponder would otherwise run out the clock
+	stopPondering();
+}
+
+void SavageAgent::assignAgents(const Board* roots, const Side* rootSides, size_t n, MCAgent** agents) {
+	bool taken[7] = { false };
+	for(size_t i = 0; i < n; i++) {
+		agents[i] = nullptr;
+		for(size_t j = 0; j < 7; j++) {
+			if(!taken[j] && mcs_[j]->hasTreeFor(roots[i], rootSides[i])) {
+				agents[i] = mcs_[j].get();
+				taken[j] = true;
+				break;
+			}
+		}
+	}
+	for(size_t i = 0, j = 0; i < n; i++) {
+		if(agents[i]) continue;
+
+		while(taken[j]) j++;
+		agents[i] = mcs_[j].get();
+		taken[j] = true;
+	}
+}
+
+uint8_t SavageAgent::predict(const Board& b, Side s) {
+	uint8_t move = books::find(s, b);
+	if(move != Book::NO_MOVE) return move;
+
+	// Our last search went through the opponent's replies, most plays is its pick
+	for(auto& mc : mcs_) {
+		move = mc->mostPlayed(b, s);
+		if(move != MCAgent::NO_MOVE) return move;
+	}
+
+	MiniMaxAgent::MoveCache cache;
+	return MiniMaxAgent::alphaBeta(b, s, 6, cache).first;
+}
+
+void SavageAgent::ponder(const Board& b, Side toMove, size_t movesSoFar) {
+	using namespace std;
+
+	stopPondering();
+	pondered_ = 0.0;
+
+	// The reply could be a swap
+	if(movesSoFar <= 1) return;
+
+	// Play out the replies we expect until it is our turn
+	const Side us = Side(int(toMove)^1);
+	Board pos = b;
+	Side s = toMove;
+	size_t nMoves;
+	while(s != us) {
+		pos.validMoves(s, nMoves);
+		if(nMoves == 0) return;
+
+		if(!pos.makeMove(s, predict(pos, s))) s = us;
+		movesSoFar++;
+	}
+
+	// Nothing makeMove would search
+	const auto* moves = pos.validMoves(us, nMoves);
+	if(nMoves <= 1 || books::find(us, pos) != Book::NO_MOVE) return;
+
+	Board roots[7];
+	Side rootSides[7];
+	for(size_t i = 0; i < nMoves; i++) {
+		roots[i] = pos;
+		rootSides[i] = roots[i].makeMove(us, moves[i]) ? us : toMove;
+	}
+
+	MCAgent* agents[7];
+	assignAgents(roots, rootSides, nMoves, agents);
+
+	ponderBoard_ = pos;
+	ponderSide_ = us;
+	ponderStart_ = chrono::steady_clock::now();
+	stop_ = false;
+
+	// They run until stopPondering, the rest of the game is just an upper bound
+	const double time = clock_.remaining();
+	for(size_t i = 0; i < nMoves; i++) {
+		MCAgent* agent = agents[i];
+		Board root = roots[i];
+		Side rootSide = rootSides[i];
+		uint8_t move = moves[i];
+		ponderJobs_[i] = pool_.submit([=]() {
+			return monteCarloPar(agent, root, rootSide, movesSoFar, move, time);
+		});
+	}
+	nPonderJobs_ = nMoves;
+}
+
+void SavageAgent::stopPondering() {
+	using namespace std::chrono;
+
+	if(nPonderJobs_ == 0) return;
+
+	stop_ = true;
+	for(size_t i = 0; i < nPonderJobs_; i++) ponderJobs_[i].get();
+	nPonderJobs_ = 0;
+
+	pondered_ = duration<double>(steady_clock::now() - ponderStart_).count();
 }
 
 uint8_t SavageAgent::makeMove(const Board& b, Side side, size_t movesSoFar, uint8_t lastMove) {
 	using namespace std;
 
+	stopPondering();
+	const bool ponderHit = pondered_ > 0.0 && ponderSide_ == side && ponderBoard_ == b;
+	const double pondered = pondered_;
+	pondered_ = 0.0;
+
+	// A new game
+	if(movesSoFar <= 1) clock_.reset();
+
 	// Swap Logic
 	if(movesSoFar == 0) return 1;
 	if(movesSoFar == 1 && (lastMove == 1 || lastMove == 2 ||  lastMove == 3 || lastMove == 4 || lastMove == 5 || lastMove == 6)) return 7;
 	
-	// Opening table
-	if(movesSoFar < 4) {
-		auto& table = side == SOUTH ? books::southBook() : books::northBook();
-		auto it = table.find(b);
-
-		if(it != table.end()) {
-			std::cerr << "USING BOOK" << std::endl;
-			return it->second;
-		} else {
-			std::cerr << "BIG PROBLEM" << std::endl;
-		}
+	// Opening table, a probe is a single hash so every position gets one
+	uint8_t bookMove = books::find(side, b);
+	if(bookMove != Book::NO_MOVE) {
+		std::cerr << "USING BOOK" << std::endl;
+		return bookMove;
 	}
 
-	double timeForThisMove = std::min(30.0, 300.0/(1.0 + 0.25 * movesSoFar));
-	double timeForMM = std::max(10.0, std::min(25.0, 0.571428 * timeForThisMove));
+	size_t nMoves;
+	const auto* moves = b.validMoves(side, nMoves);
 
-	// Spawn minimax thread
-	future<pair<uint8_t, float>> mmFuture;
-	volatile uint8_t mmMove;
-	volatile double mmScore;
-	std::function<void(uint8_t, double)> updater = [&](uint8_t m, double s) { mmMove = m; mmScore = s; };
-
-	{
-		std::packaged_task<pair<uint8_t,float>(size_t, Board, Side, double, function<void(uint8_t, double)>)>
-			mmTask(minimaxCheck);
-		mmFuture = mmTask.get_future();
-		thread t(std::move(mmTask), movesSoFar, b, side, timeForMM, updater);
-		t.detach();
+	if(nMoves == 1) return moves[0];
+
+	double timeForThisMove = clock_.startMove(b, side);
+
+	// The trees already had the opponent's time, they pick up where they were
+	if(ponderHit) {
+		std::cerr << "PONDER HIT" << std::endl;
+		timeForThisMove = max(0.05, timeForThisMove - pondered);
 	}
 
+	// Minimax gets stopped once the MC searches are done, it can have all of it too
+	const double timeForMM = timeForThisMove;
 
-	size_t nMoves;
-	const auto* moves = b.validMoves(side, nMoves);
+	stop_ = false;
 
+	// Start minimax. All it can tell us is that we have a forced win, once it
+	// has found one the MC searches can stop.
+	volatile uint8_t mmMove;
+	volatile double mmScore;
+	std::function<void(uint8_t, double)> updater = [&](uint8_t m, double s) {
+		mmMove = m;
+		mmScore = s;
+		if(forcedWin(side, s)) stop_ = true;
+	};
 
-	//Spawn MC threads
-	future<pair<uint8_t, float>> results[7];
+	future<pair<uint8_t, float>> mmFuture = pool_.submit([&]() {
+		return minimaxCheck(movesSoFar, b, side, timeForMM, updater, &stop_, mmCacheBytes_);
+	});
+
+	Board roots[7];
+	Side rootSides[7];
 	bool ga[7];
 	for(size_t i = 0; i < nMoves; i++) {
-		Board cpy = b;
-		ga[i] = cpy.makeMove(side, moves[i]);
-		
+		roots[i] = b;
+		ga[i] = roots[i].makeMove(side, moves[i]);
+		rootSides[i] = ga[i] ? side : Side(int(side)^1);
+	}
 
-		std::packaged_task<pair<uint8_t,float>(Board, Side, size_t, uint8_t, double)>
-			mcTask(monteCarloPar);
-		
-		results[i] = mcTask.get_future();
-		thread t(std::move(mcTask), cpy, ga[i] ? side : Side(int(side)^1), movesSoFar, moves[i], timeForThisMove);
-		t.detach();
+	MCAgent* agents[7];
+	assignAgents(roots, rootSides, nMoves, agents);
 
+	// Start the MC searches
+	future<pair<uint8_t, float>> results[7];
+	for(size_t i = 0; i < nMoves; i++) {
+		results[i] = pool_.submit([&, i]() {
+			return monteCarloPar(agents[i], roots[i], rootSides[i], movesSoFar, moves[i], timeForThisMove);
+		});
 	}
 
 	// Best MC option
@@ -103,9 +259,11 @@ uint8_t SavageAgent::makeMove(const Board& b, Side side, size_t movesSoFar, uint
 		}
 	}
 
-	// Waiting for MM
+	// The MC searches are done, minimax has had its chance
+	stop_ = true;
 	auto mmRes = mmFuture.get();
-	
+	clock_.endMove();
+
 	// Guaranteed win
 	if(mmRes.second > 100000.0) {
 		std::cerr << "GUARANTEED WIN" << std::endl;
@@ -1,8 +1,68 @@
 #pragma once
 
 #include "Agent.hpp"
+#include "Clock.hpp"
+#include "MCAgent.hpp"
+#include "ThreadPool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <utility>
 
 class SavageAgent : public Agent {
 public:
+	static const size_t DEFAULT_MEMORY_BUDGET = size_t(4) << 30;
+	static constexpr double DEFAULT_GAME_TIME = 3600.0;
+
+	/// memoryBudget is roughly the most the agent's searches will take, in
+	/// bytes. Each of the seven trees gets an eighth, the minimax caches the
+	/// last eighth. A tree that runs full starts recycling its nodes and full
+	/// caches stop growing, so a small budget makes the agent weaker rather
+	/// than failing.
+	///
+	/// gameTime is how many seconds the agent has for all of its moves in a
+	/// game, increment what it gets back after each of them.
+	explicit SavageAgent(size_t memoryBudget = DEFAULT_MEMORY_BUDGET, double gameTime = DEFAULT_GAME_TIME,
+	                     double increment = 0.0);
+
+	~SavageAgent();
+
 	uint8_t makeMove(const Board& board, Side side, size_t movesSoFar, uint8_t lastMove) override;
+
+	/// Guesses the opponent's reply and starts searching the position it
+	/// leaves us in. If the guess was right makeMove keeps the trees and
+	/// takes the time spent off its budget.
+	void ponder(const Board& board, Side toMove, size_t movesSoFar) override;
+	void stopPondering() override;
+
+private:
+	/// Picks an agent for each root, the one with a tree for it if there is one
+	void assignAgents(const Board* roots, const Side* rootSides, size_t n, MCAgent** agents);
+	/// The reply we expect from s, from the book, the trees or a shallow minimax
+	uint8_t predict(const Board& b, Side s);
+
+	// One tree per root move, kept around so their arenas are only mapped once
+	std::unique_ptr<MCAgent> mcs_[7];
+
+	size_t mmCacheBytes_;
+
+	// Shared by the MC searches and minimax, they run side by side
+	Clock clock_;
+
+	// Tells every search of the current move to wrap up
+	std::atomic<bool> stop_;
+
+	// Where the last ponder expected us to move, and how long it searched
+	Board ponderBoard_;
+	Side ponderSide_;
+	double pondered_;
+	std::chrono::steady_clock::time_point ponderStart_;
+	std::future<std::pair<uint8_t, float>> ponderJobs_[7];
+	size_t nPonderJobs_;
+
+	// One worker per tree and one for minimax. Declared last so it is joined
+	// before the agents its jobs use go away.
+	ThreadPool pool_;
 };
@@ -0,0 +1,40 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(size_t threads) : done_(false) {
+	for(size_t i = 0; i < threads; i++) {
+		workers_.emplace_back(&ThreadPool::work, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		done_ = true;
+	}
+	ready_.notify_all();
+
+	for(auto& w : workers_) w.join();
+}
+
+size_t ThreadPool::size() const {
+	return workers_.size();
+}
+
+void ThreadPool::work() {
+	while(true) {
+		std::function<void()> job;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			ready_.wait(lock, [this]() { return done_ || !jobs_.empty(); });
+
+			// Whatever is still queued gets run before shutting down
+			if(jobs_.empty()) return;
+
+			job = std::move(jobs_.front());
+			jobs_.pop_front();
+		}
+
+		job();
+	}
+}
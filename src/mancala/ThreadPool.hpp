@@ -0,0 +1,51 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// A fixed set of worker threads that live as long as the pool. Jobs run in
+/// the order they were submitted, whoever waits on a job's future is
+/// responsible for making it finish.
+class ThreadPool {
+public:
+	explicit ThreadPool(size_t threads);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	size_t size() const;
+
+	template<typename F>
+	auto submit(F f) -> std::future<decltype(f())>;
+
+private:
+	std::vector<std::thread> workers_;
+	std::deque<std::function<void()>> jobs_;
+	std::mutex mutex_;
+	std::condition_variable ready_;
+	bool done_;
+
+	void work();
+};
+
+template<typename F>
+auto ThreadPool::submit(F f) -> std::future<decltype(f())> {
+	// std::function needs something copyable, packaged_task isn't
+	auto task = std::make_shared<std::packaged_task<decltype(f())()>>(std::move(f));
+	auto res = task->get_future();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		jobs_.emplace_back([task]() { (*task)(); });
+	}
+	ready_.notify_one();
+
+	return res;
+}
@@ -0,0 +1,196 @@
+#include "batchplayout.hpp"
+
+#include "playout.hpp"
+
+#include <cstring>
+
+namespace playout {
+
+namespace {
+
+// GCC/Clang vector extensions, they lower to whatever SIMD the target has
+typedef uint8_t  u8x16  __attribute__((vector_size(16)));
+typedef int8_t   s8x16  __attribute__((vector_size(16)));
+typedef uint32_t u32x16 __attribute__((vector_size(64)));
+
+static_assert(BATCH_LANES == 16, "the lanes are hard coded as bytes of a 16 byte vector");
+
+inline u8x16 splat(uint8_t v) {
+	return u8x16{} + v;
+}
+
+// Comparisons give 0 or 0xff in every lane
+inline u8x16 mask(s8x16 cmp) {
+	return (u8x16)cmp;
+}
+
+inline u8x16 select(u8x16 m, u8x16 a, u8x16 b) {
+	return (a & m) | (b & ~m);
+}
+
+inline bool any(u8x16 m) {
+	uint64_t w[2];
+	memcpy(w, &m, sizeof(w));
+
+	return (w[0] | w[1]) != 0;
+}
+
+/// Structure of arrays, pits[p][lane] is pit p of the game in that lane. The
+/// pits are laid out like playout::Pits.
+struct Lanes {
+	u8x16 pits[16];
+	u8x16 north;  // 0xff where north is to move
+	u8x16 active; // 0xff where a game is being played
+	u32x16 rng;   // one xorshift32 per lane
+};
+
+/// Plays one random move in every active lane. own holds the stones in each of
+/// the mover's holes and count how many of them are non empty, which has to be
+/// at least one for every active lane. Inactive lanes have empty boards and
+/// come out of this unchanged.
+inline void __attribute__((hot)) step(Lanes& l, const u8x16 (&own)[7], u8x16 count) {
+	// Mover relative pit of every absolute one: flip the halves for north
+	const u8x16 flip = l.north & 8;
+
+	u32x16 x = l.rng;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	l.rng = x;
+
+	const u8x16 r = __builtin_convertvector(((x >> 16) * __builtin_convertvector(count, u32x16)) >> 16, u8x16);
+
+	// The r-th non empty hole
+	u8x16 hole = {};
+	u8x16 stones = {};
+	u8x16 seen = {};
+	for(uint8_t i = 0; i < 7; i++) {
+		u8x16 nonEmpty = mask(own[i] != 0);
+		u8x16 pick = nonEmpty & mask(seen == r);
+
+		hole = select(pick, splat(i), hole);
+		stones = select(pick, own[i], stones);
+		seen -= nonEmpty;
+	}
+
+	u8x16 laps = {};
+	u8x16 rest = stones;
+	for(size_t i = 0; i < 6; i++) {
+		u8x16 lap = mask(rest >= 15);
+		laps -= lap;
+		rest -= lap & 15;
+	}
+
+	// Sow into the 15 pits that aren't the opponent's well. A pit d steps after
+	// the starting hole gets a stone for every lap, plus one if d < rest.
+	for(uint8_t p = 0; p < 16; p++) {
+		u8x16 rel = splat(p) ^ flip;
+		u8x16 t = rel + 14 - hole;
+		u8x16 d = t - (mask(t >= 15) & 15);
+		u8x16 add = (laps + (mask(d < rest) & 1)) & mask(rel != 15);
+
+		l.pits[p] = (l.pits[p] & ~mask(rel == hole)) + add;
+	}
+
+	u8x16 t = hole + rest;
+	u8x16 last = t - (mask(t >= 15) & 15);
+	u8x16 again = mask(last == 7) & l.active;
+
+	// Empty hole capture, the opposite of own hole i is the opponent's hole 6-i,
+	// which is relative pit 14-i
+	u8x16 facing = 14 - last;
+	u8x16 ownLast = {};
+	u8x16 oppLast = {};
+	for(uint8_t p = 0; p < 15; p++) {
+		if(p == 7) continue;
+
+		u8x16 rel = splat(p) ^ flip;
+		ownLast |= l.pits[p] & mask(rel == last);
+		oppLast |= l.pits[p] & mask(rel == facing);
+	}
+
+	u8x16 capture = mask(last < 7) & mask(ownLast == 1) & mask(oppLast != 0);
+	if(any(capture)) {
+		for(uint8_t p = 0; p < 16; p++) {
+			u8x16 rel = splat(p) ^ flip;
+
+			if(p == 7 || p == 15) {
+				l.pits[p] += capture & mask(rel == 7) & (oppLast + 1);
+			} else {
+				l.pits[p] &= ~(capture & (mask(rel == last) | mask(rel == facing)));
+			}
+		}
+	}
+
+	l.north ^= ~again;
+}
+
+}
+
+std::tuple<uint32_t, uint32_t> batchPlayouts(const Board& b, Side toMove, size_t games) {
+	uint32_t wins[2] = { 0 };
+
+	const Pits start(b);
+	Rng& seeder = threadRng();
+
+	Lanes l;
+	memset(&l, 0, sizeof(l));
+	for(size_t i = 0; i < BATCH_LANES; i++) {
+		l.rng[i] = uint32_t(seeder.next()) | 1;
+	}
+
+	size_t started = 0;
+	auto startGame = [&](size_t lane) {
+		if(started < games) {
+			for(size_t p = 0; p < 16; p++) l.pits[p][lane] = start.p[p];
+			l.north[lane] = toMove == NORTH ? 0xff : 0;
+			l.active[lane] = 0xff;
+			started++;
+		} else {
+			for(size_t p = 0; p < 16; p++) l.pits[p][lane] = 0;
+			l.active[lane] = 0;
+		}
+	};
+
+	for(size_t i = 0; i < BATCH_LANES; i++) startGame(i);
+
+	while(any(l.active)) {
+		u8x16 own[7];
+		u8x16 count = {};
+		for(size_t i = 0; i < 7; i++) {
+			own[i] = select(l.north, l.pits[8 + i], l.pits[i]);
+			count -= mask(own[i] != 0);
+		}
+
+		u8x16 finished = l.active & (mask(count == 0) | mask(l.pits[7] > 49) | mask(l.pits[15] > 49));
+
+		if(!any(finished)) {
+			step(l, own, count);
+			continue;
+		}
+
+		// Retire finished lanes one at a time, this is rare compared to moves
+		for(size_t i = 0; i < BATCH_LANES; i++) {
+			if(!finished[i]) continue;
+
+			uint8_t scores[2] = { l.pits[7][i], l.pits[15][i] };
+			if(scores[0] <= 49 && scores[1] <= 49) {
+				// Whoever isn't stuck keeps the stones left on their side
+				scores[l.north[i] ? SOUTH : NORTH] += 98 - scores[0] - scores[1];
+			}
+
+			if(scores[0] > scores[1])      wins[0] += 2;
+			else if(scores[0] < scores[1]) wins[1] += 2;
+			else {
+				wins[0]++;
+				wins[1]++;
+			}
+
+			startGame(i);
+		}
+	}
+
+	return std::make_tuple(wins[0], wins[1]);
+}
+
+}
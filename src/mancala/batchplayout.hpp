@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Board.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+
+namespace playout {
+
+/// How many games batchPlayouts plays side by side
+const size_t BATCH_LANES = 16;
+
+/// Below this many games the lanes can't be kept busy and randomPlayouts is faster
+const size_t BATCH_MIN_GAMES = 32;
+
+/// Same results as randomPlayouts, but plays BATCH_LANES games in lock-step
+/// with one byte lane per game. Finished lanes are refilled with a fresh game
+/// until all of them have been started.
+std::tuple<uint32_t, uint32_t> batchPlayouts(const Board& b, Side toMove, size_t games);
+
+}
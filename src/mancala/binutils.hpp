@@ -9,5 +9,4 @@
 namespace binutils {
 	// little endian, or else!
 	std::unordered_map<Board, uint8_t> readBook(std::istream& in);
-	std::unordered_map<Board, float>  readVBook(std::istream& in);
 }
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// The minimal perfect hash the opening books are compiled into. bookgen
+/// builds the tables at build time and books.cpp probes them, both with
+/// these functions.
+///
+/// A key's 64 bit hash picks a bucket with its high half. Every bucket has a
+/// displacement, chosen by bookgen so that the low half mixed with it sends
+/// every key to a slot of its own.
+namespace bookhash {
+
+	static const size_t KEY_BYTES = 16;
+
+	// Values are the side to move's chance to win, stored in steps of
+	// 1/VALUE_STEPS. Positions without one hold NO_VALUE.
+	static const uint16_t VALUE_STEPS = 0xfffe;
+	static const uint16_t NO_VALUE = 0xffff;
+
+	struct Entry {
+		uint8_t key[KEY_BYTES];
+		uint8_t move;
+		uint16_t value;
+	};
+
+	/// Anything negative, or NaN, is NO_VALUE
+	inline uint16_t packValue(float v) {
+		if(!(v >= 0.0f)) return NO_VALUE;
+		if(v >= 1.0f) return VALUE_STEPS;
+		return uint16_t(v * VALUE_STEPS + 0.5f);
+	}
+
+	/// NO_VALUE comes back as -1
+	inline float unpackValue(uint16_t v) {
+		return v == NO_VALUE ? -1.0f : v / float(VALUE_STEPS);
+	}
+
+	inline uint64_t load64(const uint8_t* p) {
+		uint64_t v = 0;
+		for(size_t i = 0; i < 8; i++) v |= uint64_t(p[i]) << (8 * i);
+		return v;
+	}
+
+	// murmur3's finalizers
+	inline uint64_t mix64(uint64_t h) {
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ull;
+		h ^= h >> 33;
+		return h;
+	}
+
+	inline uint32_t mix32(uint32_t h) {
+		h ^= h >> 16;
+		h *= 0x85ebca6bu;
+		h ^= h >> 13;
+		h *= 0xc2b2ae35u;
+		h ^= h >> 16;
+		return h;
+	}
+
+	inline uint64_t hash(const uint8_t* key) {
+		return mix64(load64(key) ^ mix64(load64(key + 8) + 0x9e3779b97f4a7c15ull));
+	}
+
+	inline uint32_t bucket(uint64_t h, uint32_t buckets) {
+		return uint32_t(h >> 32) % buckets;
+	}
+
+	// Mixed again after the xor, otherwise keys that share their low bits
+	// land together in any power of two table whatever the displacement
+	inline uint32_t slot(uint64_t h, uint32_t displacement, uint32_t slots) {
+		return mix32(uint32_t(h) ^ mix32(displacement)) % slots;
+	}
+
+	inline uint32_t fnv1a(const uint8_t* p, size_t bytes) {
+		uint32_t h = 2166136261u;
+		for(size_t i = 0; i < bytes; i++) {
+			h ^= p[i];
+			h *= 16777619u;
+		}
+
+		return h;
+	}
+}
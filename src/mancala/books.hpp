@@ -3,13 +3,22 @@
 #include "Board.hpp"
 
 #include <cstddef>
+#include <cstdint>
 #include <utility>
-#include <unordered_map>
 
+/// The opening book compiled into the binary. bookgen turns data/book.mkb
+/// into a perfect hash table at build time, so a lookup is one hash and one
+/// compare with nothing to set up first.
+///
+/// The book holds canonical positions (see canonical in Board.hpp), one
+/// table serves both sides.
 namespace books {
-	std::pair<const char*, size_t> southBookBin();
-	std::pair<const char*, size_t> northBookBin();
+	/// The book move for side in b, or Book::NO_MOVE
+	uint8_t find(Side side, const Board& b);
+	/// side's chance to win b with side to move, or Book::NO_VALUE
+	float value(Side side, const Board& b);
 
-	const std::unordered_map<Board, uint8_t>& southBook();
-	const std::unordered_map<Board, uint8_t>& northBook();
+	size_t size();
+	/// The i-th position, with south to move, and its move
+	std::pair<Board, uint8_t> entry(size_t i);
 }
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Board.hpp"
+
+#include <cstdint>
+
+// Static evaluations, shared by MiniMaxAgent and the MCTS leaf evaluation
+
+/// Whether some hole of s before idx holds exactly enough stones to end its sowing in idx
+inline bool isSeedable(const Board& b, Side s, uint8_t idx) {
+	bool toRet = false;
+	int8_t cur = idx - 1;
+
+	do {
+		if(cur < 0) break;
+		if(idx - cur == b.stonesInHole(s, cur)) {
+			toRet = true;
+			break;
+		}
+		cur--;
+	} while(true);
+
+	return toRet;
+}
+
+/// How good b looks for s, positive when s is ahead
+inline double jimmy_heuristic(const Board& b, Side s) {
+	Side o = Side(int(s)^1);
+	double d = 0.0;
+
+	double ourWell = b.stonesInWell(s);
+	double oppWell = b.stonesInWell(o);
+	if((ourWell != 0.0 || oppWell != 0.0) && ourWell != oppWell) {
+		double bigWell;
+		double smallWell;
+		if(ourWell > oppWell) {
+			bigWell = ourWell;
+			smallWell = oppWell;
+		} else {
+			bigWell = oppWell;
+			smallWell = ourWell;
+		}
+		d = ((1.0 / bigWell) * (bigWell - smallWell) + 1.0) * bigWell;
+		if(oppWell > ourWell) d *= -1;
+	}
+
+	size_t N;
+	const auto* moves = b.validMoves(s, N);
+
+	int ourSum = 0;
+	for(size_t i = 0; i < N; i++) {
+		ourSum += b.stonesInHole(s, moves[i]);
+	}
+
+	int oppSum = 98 - ourWell - oppWell - ourSum;
+
+	d += (ourSum - oppSum) / 2.0;
+
+	for(uint8_t i = 0; i < 7; i++) {
+		if(b.stonesInHole(o, i) == 0 && isSeedable(b, o, i)) {
+			d -= b.stonesInHole(s, 6-i);
+		}
+	}
+
+	return d;
+}
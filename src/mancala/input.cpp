@@ -1,104 +1,104 @@
 #include "input.hpp"
 
 #include <cassert>
-#include <string>
-#include <sstream>
-#include <vector>
+#include <cstring>
+#include <limits>
 
-static std::vector<std::string> split_i(const std::string& s, char d, std::vector<std::string>& v) {
-	std::stringstream ss(s);
+// The longest message, a CHANGE with two digits everywhere, is 63 characters
+static const size_t LINE_BYTES = 128;
 
-	std::string cur;
-	while(std::getline(ss, cur, d)) {
-		v.push_back(cur);
+/// Reads a decimal number at p and moves p past it
+static uint8_t getNumber(const char*& p) {
+	assert('0' <= *p && *p <= '9');
+
+	unsigned v = 0;
+	while('0' <= *p && *p <= '9') {
+		v = 10 * v + unsigned(*p++ - '0');
 	}
+	assert(v <= 98);
 
-	return v;
+	return (uint8_t) v;
 }
 
-static std::vector<std::string> split(const std::string& s, char delim) {
-	std::vector<std::string> toRet;
-	split_i(s, delim, toRet);
-
-	return toRet;
-}
+namespace input {
 
-static uint8_t getNumber(const std::string& s) {
-	auto v = std::stoul(s);
-	assert(v <= 98);
+static Message ofType(Message::Type type) {
+	Message m;
+	m.type = type;
 
-	return (uint8_t) v;
+	return m;
 }
 
-namespace input {
+static Message parseStart(const char* in) {
+	assert(strcmp(in, "START;North") == 0 || strcmp(in, "START;South") == 0);
 
-Start* parseStart(std::string& in) {
-	assert(in == "START;North" || in == "START;South");
-	
-	return new Start(in[6] == 'N' ? NORTH : SOUTH);
+	Message m = ofType(Message::START);
+	m.side = in[6] == 'N' ? NORTH : SOUTH;
+
+	return m;
 }
 
-Change* parseChange(std::string& in) {
-	std::vector<std::string> tokens = split(in, ';');
-	assert(tokens.size() == 4);
-	assert(tokens[0] == "CHANGE");
+static Message parseChange(const char* in) {
+	assert(strncmp(in, "CHANGE;", 7) == 0);
+	const char* p = in + 7;
 
-	Board board;
-	bool ourTurn;
-	uint8_t lastMove;
+	Message m = ofType(Message::CHANGE);
 
-	
-	lastMove = ('1' <= tokens[1][0] && tokens[1][0] < '8') ? tokens[1][0] - '1'
-	                                                       : 7;
-	std::vector<std::string> stones = split(tokens[2], ',');
-	assert(stones.size() == 16);
+	m.lastMove = ('1' <= p[0] && p[0] < '8') ? p[0] - '1'
+	                                         : 7;
+	p = strchr(p, ';');
+	assert(p);
+	p++;
 
-	//North holes
-	for(size_t i = 0; i < 7; i++) {
-		board.stonesInHole(NORTH, i) = getNumber(stones[i]);
-	}
-	
-	//North well
-	{
-		board.stonesInWell(NORTH) = getNumber(stones[7]);
+	// North's holes and well, then south's
+	uint8_t stones[16];
+	for(size_t i = 0; i < 16; i++) {
+		stones[i] = getNumber(p);
+
+		assert(*p == (i < 15 ? ',' : ';'));
+		p++;
 	}
 
-	//South holes
+	Board& board = m.current;
 	for(size_t i = 0; i < 7; i++) {
-		board.stonesInHole(SOUTH, i) = getNumber(stones[i + 8]);
-	}
-	
-	//South well
-	{
-		board.stonesInWell(SOUTH) = getNumber(stones[15]);
+		board.stonesInHole(NORTH, i) = stones[i];
+		board.stonesInHole(SOUTH, i) = stones[i + 8];
 	}
+	board.stonesInWell(NORTH) = stones[7];
+	board.stonesInWell(SOUTH) = stones[15];
 
 	board.recalcMoves();
 
-	assert(tokens[3] == "YOU" || tokens[3] == "OPP" || tokens[3] == "END");
-	ourTurn = tokens[3][0] == 'Y';
+	assert(strcmp(p, "YOU") == 0 || strcmp(p, "OPP") == 0 || strcmp(p, "END") == 0);
+	m.ourTurn = p[0] == 'Y';
 
-	return new Change(board, ourTurn, lastMove);
+	return m;
 }
 
-std::unique_ptr<Message> parseNext(std::istream& in) {
-	std::string line;
-	std::getline(in, line);
+Message parseNext(std::istream& in) {
+	char line[LINE_BYTES];
+	in.getline(line, sizeof(line));
+
+	// Nothing there, or far too long to be anything we know
+	if(in.fail()) {
+		if(!in.eof()) {
+			in.clear();
+			in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+		}
+
+		return ofType(Message::NO_INPUT);
+	}
 
-	Message* m = nullptr;
-	
 	switch(line[0]) {
 	case 'C':
-		m = parseChange(line); break;
+		return parseChange(line);
 	case 'S':
-		m = parseStart(line); break;
+		return parseStart(line);
 	case 'E':
-		m = new GameOver; break;
+		return ofType(Message::GAME_OVER);
 	default:
-		m = new NoInput; break;
+		return ofType(Message::NO_INPUT);
 	}
-
-	return std::unique_ptr<Message>(m);
 }
 
 }
@@ -2,33 +2,33 @@
 
 #include <mancala/Board.hpp>
 
-#include <memory>
 #include <istream>
 
 namespace input {
 
+/// One message from the game engine. Which fields mean anything depends on
+/// the type, the rest are left as they are.
 struct Message {
-	virtual ~Message() {}
-};
+	enum Type : uint8_t {
+		START,
+		CHANGE,
+		GAME_OVER,
+		// Useful if/when we switch to non-blocking IO
+		NO_INPUT,
+	};
+
+	Type type;
 
-struct Start : public Message {
-	Start(Side s) : side(s) {}
+	// START
 	Side side;
-};
 
-struct Change : public Message {
-	Change(const Board& b, bool ourTur, uint8_t lastMov) : current(b), ourTurn(ourTur), lastMove(lastMov) {}
+	// CHANGE
 	Board current;
 	bool ourTurn;
 	uint8_t lastMove;
 };
 
-struct GameOver : public Message {};
-
-// Useful if/when we switch to non-blocking IO
-struct NoInput : public Message {};
-
-
-std::unique_ptr<Message> parseNext(std::istream& in);
+/// Reads one line and parses it where it lies, nothing gets allocated
+Message parseNext(std::istream& in);
 
 }
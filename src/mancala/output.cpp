@@ -2,7 +2,7 @@
 
 namespace output {
 
-static std::string moves[] = {
+static const std::string moves[] = {
 	"MOVE;1\n",
 	"MOVE;2\n",
 	"MOVE;3\n",
@@ -13,7 +13,7 @@ static std::string moves[] = {
 	"SWAP\n",
 };
 
-std::string move(size_t hole) {
+const std::string& move(size_t hole) {
 	return hole < 7 ? moves[hole] : moves[7];
 }
 
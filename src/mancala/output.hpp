@@ -1,10 +1,12 @@
 #pragma once
 
-#include <cstdint>
+#include <cstddef>
 #include <string>
 
 namespace output {
 
-std::string move(size_t hole);
+/// The line to send for a move, holes >= 7 swap. It is a constant, nothing
+/// gets built per move.
+const std::string& move(size_t hole);
 
 }
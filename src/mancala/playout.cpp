@@ -0,0 +1,287 @@
+#include "playout.hpp"
+
+#include <cstring>
+#include <random>
+
+namespace playout {
+
+static inline uint64_t rotl(uint64_t x, int k) {
+	return (x << k) | (x >> (64 - k));
+}
+
+Rng::Rng(uint64_t seed) {
+	// splitmix64 to spread the seed over the whole state
+	for(auto& s : s_) {
+		uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		s = z ^ (z >> 31);
+	}
+}
+
+uint64_t Rng::next() {
+	const uint64_t result = rotl(s_[1] * 5, 7) * 9;
+	const uint64_t t = s_[1] << 17;
+
+	s_[2] ^= s_[0];
+	s_[3] ^= s_[1];
+	s_[1] ^= s_[2];
+	s_[0] ^= s_[3];
+	s_[2] ^= t;
+	s_[3] = rotl(s_[3], 45);
+
+	return result;
+}
+
+Rng& threadRng() {
+	static thread_local Rng rng((uint64_t(std::random_device{}()) << 32) | std::random_device{}());
+	return rng;
+}
+
+Pits::Pits(const Board& b) {
+	for(size_t i = 0; i < 7; i++) {
+		hole(SOUTH, i) = b.stonesInHole(SOUTH, i);
+		hole(NORTH, i) = b.stonesInHole(NORTH, i);
+	}
+	well(SOUTH) = b.stonesInWell(SOUTH);
+	well(NORTH) = b.stonesInWell(NORTH);
+}
+
+Board Pits::toBoard() const {
+	Board b;
+	b.clear();
+
+	for(size_t i = 0; i < 7; i++) {
+		b.stonesInHole(SOUTH, i) = hole(SOUTH, i);
+		b.stonesInHole(NORTH, i) = hole(NORTH, i);
+	}
+	b.stonesInWell(SOUTH) = well(SOUTH);
+	b.stonesInWell(NORTH) = well(NORTH);
+	b.recalcMoves();
+
+	return b;
+}
+
+uint8_t Pits::moveMask(Side s) const {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	// Flag the non empty bytes, then gather one bit per byte with a multiply
+	uint64_t v;
+	memcpy(&v, p + 8 * s, sizeof(v));
+
+	const uint64_t lo7 = 0x7f7f7f7f7f7f7f7full;
+	uint64_t nonZero = (((v & lo7) + lo7) | v) & ~lo7;
+
+	return uint8_t(((nonZero >> 7) * 0x0102040810204080ull) >> 56) & 0x7f;
+#else
+	uint8_t mask = 0;
+	for(size_t i = 0; i < 7; i++) {
+		mask |= uint8_t(hole(s, i) != 0) << i;
+	}
+	return mask;
+#endif
+}
+
+namespace {
+
+// What sowing rest < 15 stones from a hole adds to the mover's 8 pits and the
+// opponent's 8 pits, as words that can be added to the board in one go. No
+// byte can ever carry into the next one as there are only 98 stones.
+struct SowTable {
+	struct Step {
+		uint64_t own;
+		uint64_t opp;
+		uint8_t last;
+	};
+
+	Step steps[7][15];
+	uint64_t lapOwn;
+	uint64_t lapOpp;
+
+	SowTable() {
+		for(size_t hole = 0; hole < 7; hole++) {
+			for(size_t rest = 0; rest < 15; rest++) {
+				uint8_t own[8] = { 0 };
+				uint8_t opp[8] = { 0 };
+
+				size_t cur = hole;
+				for(size_t i = 0; i < rest; i++) {
+					cur = cur == 14 ? 0 : cur + 1;
+					if(cur < 8) own[cur]++;
+					else        opp[cur - 8]++;
+				}
+
+				memcpy(&steps[hole][rest].own, own, 8);
+				memcpy(&steps[hole][rest].opp, opp, 8);
+				steps[hole][rest].last = cur;
+			}
+		}
+
+		const uint8_t own[8] = { 1, 1, 1, 1, 1, 1, 1, 1 };
+		const uint8_t opp[8] = { 1, 1, 1, 1, 1, 1, 1, 0 };
+		memcpy(&lapOwn, own, 8);
+		memcpy(&lapOpp, opp, 8);
+	}
+};
+
+const SowTable SOW;
+
+// The index of the n-th set bit of each 7 bit move mask
+struct PickTable {
+	uint8_t nth[128][7];
+
+	PickTable() {
+		for(size_t mask = 0; mask < 128; mask++) {
+			size_t n = 0;
+			for(size_t i = 0; i < 7; i++) {
+				nth[mask][i] = 0;
+				if(mask & (1 << i)) nth[mask][n++] = i;
+			}
+		}
+	}
+};
+
+const PickTable PICK;
+
+}
+
+size_t __attribute__((hot)) pickMove(uint8_t mask, Rng& rng) {
+	return PICK.nth[mask][rng.below(__builtin_popcount(mask))];
+}
+
+bool __attribute__((hot)) Pits::makeMove(Side s, size_t holeNo) {
+	uint8_t* own = p + 8 * s;
+	uint8_t* opp = p + 8 * (s ^ 1);
+
+	uint8_t stones = own[holeNo];
+	own[holeNo] = 0;
+
+	// Every full lap puts a stone in each of the 15 pits we sow into
+	const SowTable::Step& step = SOW.steps[holeNo][stones % 15];
+	const uint64_t laps = stones / 15;
+
+	uint64_t ownWord, oppWord;
+	memcpy(&ownWord, own, 8);
+	memcpy(&oppWord, opp, 8);
+	ownWord += step.own + laps * SOW.lapOwn;
+	oppWord += step.opp + laps * SOW.lapOpp;
+	memcpy(own, &ownWord, 8);
+	memcpy(opp, &oppWord, 8);
+
+	const size_t last = step.last;
+	if(last == 7) return true;
+
+	// Empty hole capture, which can't happen after more than a full lap
+	if(last < 7 && own[last] == 1 && opp[6 - last] > 0) {
+		own[7] += opp[6 - last] + 1;
+		opp[6 - last] = 0;
+		own[last] = 0;
+	}
+
+	return false;
+}
+
+namespace {
+
+template<bool TRACK>
+inline Result playGame(Pits pits, Side toMove, Rng& rng, uint8_t* played) {
+	while(pits.well(SOUTH) <= 49 && pits.well(NORTH) <= 49) {
+		uint8_t mask = pits.moveMask(toMove);
+
+		if(mask == 0) {
+			// Whoever isn't stuck keeps the stones left on their side
+			uint8_t scores[2] = { pits.well(SOUTH), pits.well(NORTH) };
+			scores[toMove ^ 1] += 98 - scores[0] - scores[1];
+
+			return scores[0] > scores[1] ? SOUTH_WON :
+			       scores[0] < scores[1] ? NORTH_WON :
+			                               DRAW;
+		}
+
+		size_t move = pickMove(mask, rng);
+		if(TRACK) played[toMove] |= uint8_t(1 << move);
+
+		if(!pits.makeMove(toMove, move)) {
+			toMove = Side(toMove ^ 1);
+		}
+	}
+
+	return pits.well(SOUTH) > 49 ? SOUTH_WON : NORTH_WON;
+}
+
+}
+
+bool advance(Pits& pits, Side& toMove, size_t plies, Rng& rng) {
+	for(size_t i = 0; i < plies; i++) {
+		if(pits.well(SOUTH) > 49 || pits.well(NORTH) > 49) return false;
+
+		uint8_t mask = pits.moveMask(toMove);
+		if(mask == 0) return false;
+
+		if(!pits.makeMove(toMove, pickMove(mask, rng))) {
+			toMove = Side(toMove ^ 1);
+		}
+	}
+
+	return pits.well(SOUTH) <= 49 && pits.well(NORTH) <= 49 && pits.moveMask(toMove) != 0;
+}
+
+Result outcome(const Pits& pits, Side toMove) {
+	if(pits.well(SOUTH) > 49) return SOUTH_WON;
+	if(pits.well(NORTH) > 49) return NORTH_WON;
+
+	// Whoever isn't stuck keeps the stones left on their side
+	uint8_t scores[2] = { pits.well(SOUTH), pits.well(NORTH) };
+	scores[toMove ^ 1] += 98 - scores[0] - scores[1];
+
+	return scores[0] > scores[1] ? SOUTH_WON :
+	       scores[0] < scores[1] ? NORTH_WON :
+	                               DRAW;
+}
+
+Result __attribute__((hot)) play(Pits pits, Side toMove, Rng& rng) {
+	return playGame<false>(pits, toMove, rng, nullptr);
+}
+
+Result __attribute__((hot)) play(Pits pits, Side toMove, Rng& rng, uint8_t played[2]) {
+	return playGame<true>(pits, toMove, rng, played);
+}
+
+std::tuple<uint32_t, uint32_t> randomPlayouts(const Board& b, Side toMove, size_t games) {
+	uint32_t wins[3] = { 0 };
+
+	const Pits start(b);
+	Rng& rng = threadRng();
+
+	for(size_t i = 0; i < games; i++) {
+		wins[play(start, toMove, rng)] += 2;
+	}
+
+	return std::make_tuple(wins[SOUTH_WON] + wins[DRAW] / 2, wins[NORTH_WON] + wins[DRAW] / 2);
+}
+
+std::tuple<uint32_t, uint32_t> randomPlayouts(const Board& b, Side toMove, size_t games, MoveCounts& counts) {
+	uint32_t wins[3] = { 0 };
+
+	const Pits start(b);
+	Rng& rng = threadRng();
+
+	for(size_t i = 0; i < games; i++) {
+		uint8_t played[2] = { 0, 0 };
+		Result r = play(start, toMove, rng, played);
+		wins[r] += 2;
+
+		for(size_t s = 0; s < 2; s++) {
+			const uint32_t score = r == DRAW ? 1 : r == Result(s) ? 2 : 0;
+
+			for(uint8_t m = played[s]; m; m &= m - 1) {
+				size_t hole = __builtin_ctz(m);
+				counts.plays[s][hole] += 2;
+				counts.wins[s][hole] += score;
+			}
+		}
+	}
+
+	return std::make_tuple(wins[SOUTH_WON] + wins[DRAW] / 2, wins[NORTH_WON] + wins[DRAW] / 2);
+}
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Board.hpp"
+
+#include <cstdint>
+#include <tuple>
+
+/// A stripped down random game engine for Monte Carlo playouts. It skips Game,
+/// Agent and the move lists kept by Board, and plays straight on a flat array.
+namespace playout {
+
+/// xoshiro256**, small and plenty random for playouts
+class Rng {
+public:
+	explicit Rng(uint64_t seed);
+
+	uint64_t next();
+
+	/// Uniform in [0, n), n has to be small
+	inline uint32_t below(uint32_t n);
+
+private:
+	uint64_t s_[4];
+};
+
+inline uint32_t Rng::below(uint32_t n) {
+	// Multiply and shift instead of rejection, the bias is negligible for n <= 7
+	return uint32_t(((next() >> 32) * n) >> 32);
+}
+
+/// Seeded from std::random_device the first time each thread asks for it
+Rng& threadRng();
+
+/// The board laid out in sowing order: south holes, south well, north holes, north well
+struct Pits {
+	uint8_t p[16];
+
+	Pits() {}
+	explicit Pits(const Board& b);
+
+	inline uint8_t& hole(Side s, size_t holeNo) { return p[8 * s + holeNo]; }
+	inline uint8_t& well(Side s) { return p[8 * s + 7]; }
+	inline uint8_t hole(Side s, size_t holeNo) const { return p[8 * s + holeNo]; }
+	inline uint8_t well(Side s) const { return p[8 * s + 7]; }
+
+	/// Back to a full Board, move lists included
+	Board toBoard() const;
+
+	/// Bit i is set when hole i of side s is not empty
+	uint8_t moveMask(Side s) const;
+
+	/// Same rules as Board::makeMove, returns true if s goes again
+	bool makeMove(Side s, size_t holeNo);
+};
+
+/// Who won a playout
+enum Result : uint8_t { SOUTH_WON = 0, NORTH_WON = 1, DRAW = 2 };
+
+/// Picks one of the set bits in mask uniformly, mask has to be non zero
+size_t pickMove(uint8_t mask, Rng& rng);
+
+/// Plays random moves until someone has more than half the stones or toMove can't move
+Result play(Pits pits, Side toMove, Rng& rng);
+
+/// Plays at most plies random moves. Returns false if the game ended on the
+/// way, either way pits and toMove are left at the last position reached.
+bool advance(Pits& pits, Side& toMove, size_t plies, Rng& rng);
+
+/// Who won a game that advance finished
+Result outcome(const Pits& pits, Side toMove);
+
+/// Same as play, also sets bit i of played[s] whenever s moves from hole i
+Result play(Pits pits, Side toMove, Rng& rng, uint8_t played[2]);
+
+/// Which moves came up over a number of games, for all-moves-as-first
+/// statistics. plays[s][i] counts the games in which s moved from hole i and
+/// wins[s][i] what s scored in them, both counted like MCAgent does.
+struct MoveCounts {
+	uint32_t plays[2][7];
+	uint32_t wins[2][7];
+};
+
+/// South wins, north wins. A win counts 2 and a draw 1 for each side, like in MCAgent.
+std::tuple<uint32_t, uint32_t> randomPlayouts(const Board& b, Side toMove, size_t games);
+
+/// randomPlayouts that also adds the moves of every game to counts
+std::tuple<uint32_t, uint32_t> randomPlayouts(const Board& b, Side toMove, size_t games, MoveCounts& counts);
+
+}
@@ -0,0 +1,53 @@
+#include <mancala/Book.hpp>
+#include <mancala/binutils.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+// Merges a south and a north book in the unsorted format opening used to
+// write (a u32 count, then the first 16 bytes of each Board and its move)
+// into one Book file of canonical positions. Where both books have the same
+// canonical position south's move is kept. The book compiled into the bot
+// is data/book.mkb.
+//
+// usage: bookconv <old south book> <old north book> <new book>
+
+int main(int argc, char** argv) {
+	if(argc != 4) {
+		std::cerr << "usage: bookconv <old south book> <old north book> <new book>" << std::endl;
+		return 1;
+	}
+
+	std::unordered_map<Board, uint8_t> merged;
+	size_t disagree = 0;
+
+	for(Side s : { SOUTH, NORTH }) {
+		const char* path = argv[1 + s];
+		std::ifstream in(path, std::ios::binary);
+		if(!in) {
+			std::cerr << "Could not open " << path << std::endl;
+			return 1;
+		}
+
+		for(const auto& e : binutils::readBook(in)) {
+			auto res = merged.insert(std::make_pair(canonical(e.first, s), e.second));
+			if(!res.second && res.first->second != e.second) disagree++;
+		}
+	}
+
+	std::vector<std::pair<Board, uint8_t>> entries(merged.begin(), merged.end());
+	std::vector<uint8_t> bytes = Book::encode(entries);
+
+	std::ofstream out(argv[3], std::ios::binary);
+	out.write((const char*) bytes.data(), bytes.size());
+	if(!out) {
+		std::cerr << "Could not write " << argv[3] << std::endl;
+		return 1;
+	}
+
+	std::cerr << "Converted " << entries.size() << " entries, the books disagree on " << disagree << std::endl;
+
+	return 0;
+}
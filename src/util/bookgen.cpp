@@ -0,0 +1,155 @@
+#include <mancala/bookhash.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Turns the opening book (see Book.hpp for the file format) into a header with
+// a constexpr minimal perfect hash table for books.cpp. Runs as part of the
+// build, so it can't use the mancala library.
+//
+// usage: bookgen <book> <output header>
+
+struct Table {
+	std::vector<uint32_t> displacements;
+	std::vector<bookhash::Entry> slots;
+};
+
+static bool readBook(const char* path, std::vector<bookhash::Entry>& entries) {
+	std::ifstream in(path, std::ios::binary);
+	std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	const size_t header = 16, entry = bookhash::KEY_BYTES + 3;
+	if(bytes.size() < header || memcmp(bytes.data(), "MKBK", 4) != 0) {
+		std::cerr << path << " is not a book" << std::endl;
+		return false;
+	}
+
+	uint16_t version = bytes[4] | bytes[5] << 8;
+	uint16_t entryBytes = bytes[6] | bytes[7] << 8;
+	uint32_t count = 0, checksum = 0;
+	for(size_t i = 0; i < 4; i++) {
+		count |= uint32_t(bytes[8 + i]) << (8 * i);
+		checksum |= uint32_t(bytes[12 + i]) << (8 * i);
+	}
+
+	if(version != 2 || entryBytes != entry || bytes.size() != header + size_t(count) * entry) {
+		std::cerr << path << " has an unknown version or the wrong size" << std::endl;
+		return false;
+	}
+	if(count == 0 || bookhash::fnv1a(bytes.data() + header, count * entry) != checksum) {
+		std::cerr << path << " is empty or corrupt" << std::endl;
+		return false;
+	}
+
+	entries.resize(count);
+	for(size_t i = 0; i < count; i++) {
+		const uint8_t* e = bytes.data() + header + i * entry;
+		memcpy(entries[i].key, e, bookhash::KEY_BYTES);
+		entries[i].move = e[bookhash::KEY_BYTES];
+		entries[i].value = e[bookhash::KEY_BYTES + 1] | e[bookhash::KEY_BYTES + 2] << 8;
+	}
+
+	return true;
+}
+
+// Hash and displace: the biggest buckets go first while most slots are free,
+// each one gets the first displacement that puts all of its keys somewhere new
+static bool build(const std::vector<bookhash::Entry>& entries, Table& t) {
+	const uint32_t n = entries.size();
+	const uint32_t nBuckets = std::max(1u, n / 4);
+
+	std::vector<uint64_t> hashes(n);
+	std::vector<std::vector<uint32_t>> buckets(nBuckets);
+	for(uint32_t i = 0; i < n; i++) {
+		hashes[i] = bookhash::hash(entries[i].key);
+		buckets[bookhash::bucket(hashes[i], nBuckets)].push_back(i);
+	}
+
+	std::vector<uint32_t> order(nBuckets);
+	for(uint32_t i = 0; i < nBuckets; i++) order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return buckets[a].size() > buckets[b].size();
+	});
+
+	std::vector<bool> taken(n, false);
+	std::vector<uint32_t> slots;
+	t.displacements.assign(nBuckets, 0);
+	t.slots.assign(n, bookhash::Entry());
+
+	for(uint32_t b : order) {
+		if(buckets[b].empty()) break;
+
+		uint32_t d = 0;
+		for(;; d++) {
+			if(d == (1u << 24)) return false;
+
+			slots.clear();
+			for(uint32_t i : buckets[b]) {
+				uint32_t s = bookhash::slot(hashes[i], d, n);
+				if(taken[s] || std::find(slots.begin(), slots.end(), s) != slots.end()) break;
+				slots.push_back(s);
+			}
+
+			if(slots.size() == buckets[b].size()) break;
+		}
+
+		t.displacements[b] = d;
+		for(size_t i = 0; i < slots.size(); i++) {
+			taken[slots[i]] = true;
+			t.slots[slots[i]] = entries[buckets[b][i]];
+		}
+	}
+
+	return true;
+}
+
+static void emit(FILE* out, const std::string& name, const Table& t) {
+	fprintf(out, "constexpr uint32_t %sDisplacements[] = {", name.c_str());
+	for(size_t i = 0; i < t.displacements.size(); i++) {
+		fprintf(out, "%s%u,", i % 16 == 0 ? "\n\t" : " ", t.displacements[i]);
+	}
+	fprintf(out, "\n};\n\n");
+
+	fprintf(out, "constexpr bookhash::Entry %sEntries[] = {\n", name.c_str());
+	for(const auto& e : t.slots) {
+		fprintf(out, "\t{ {");
+		for(size_t i = 0; i < bookhash::KEY_BYTES; i++) fprintf(out, "%s%u", i ? "," : "", e.key[i]);
+		fprintf(out, "}, %u, %u },\n", e.move, e.value);
+	}
+	fprintf(out, "};\n\n");
+}
+
+int main(int argc, char** argv) {
+	if(argc != 3) {
+		std::cerr << "usage: bookgen <book> <output header>" << std::endl;
+		return 1;
+	}
+
+	std::vector<bookhash::Entry> entries;
+	if(!readBook(argv[1], entries)) return 1;
+
+	Table table;
+	if(!build(entries, table)) {
+		std::cerr << "Could not find a perfect hash for " << argv[1] << std::endl;
+		return 1;
+	}
+
+	FILE* out = fopen(argv[2], "w");
+	if(!out) {
+		std::cerr << "Could not write " << argv[2] << std::endl;
+		return 1;
+	}
+
+	fprintf(out, "// Generated by bookgen, do not edit\n\n");
+	fprintf(out, "#pragma once\n\n#include <mancala/bookhash.hpp>\n\nnamespace books {\nnamespace tables {\n\n");
+	emit(out, "book", table);
+	fprintf(out, "}\n}\n");
+
+	return fclose(out) == 0 ? 0 : 1;
+}
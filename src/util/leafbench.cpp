@@ -0,0 +1,79 @@
+#include <mancala/Game.hpp>
+#include <mancala/MCAgent.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+// Compares the MCTS leaf evaluations on search speed and on strength against
+// full rollouts with the same time per move.
+//
+// usage: leafbench [games per match] [seconds per move]
+
+static const char* names[3] = { "rollout", "evaluate", "truncated" };
+
+static MCAgent* makeAgent(MCAgent::LeafMode mode) {
+	MCAgent* a = new MCAgent(5000000, 1, 1);
+	a->leafMode() = mode;
+	return a;
+}
+
+static double iterationsPerSec(MCAgent::LeafMode mode, const Board& b, Side toMove) {
+	using namespace std::chrono;
+	const uint32_t iterations = 300000;
+
+	MCAgent* a = makeAgent(mode);
+	a->iterations() = iterations;
+
+	auto before = high_resolution_clock::now();
+	a->makeMoveAndScore(b, toMove, 2, 0);
+	auto after = high_resolution_clock::now();
+
+	delete a;
+	return iterations / duration_cast<duration<double>>(after - before).count();
+}
+
+int main(int argc, char** argv) {
+	const size_t games = argc > 1 ? atoi(argv[1]) : 20;
+	const float timePerMove = argc > 2 ? atof(argv[2]) : 0.2f;
+
+	Board b;
+	b.reset();
+	b.makeMove(SOUTH, 3);
+
+	double base = iterationsPerSec(MCAgent::ROLLOUT, b, NORTH);
+	for(size_t m = 0; m < 3; m++) {
+		double its = m == 0 ? base : iterationsPerSec(MCAgent::LeafMode(m), b, NORTH);
+		std::cout << names[m] << ": " << its << " iterations/s (" << its / base << "x)" << std::endl;
+	}
+
+	for(size_t m = 1; m < 3; m++) {
+		size_t won = 0, lost = 0, drawn = 0;
+
+		for(size_t i = 0; i < games; i++) {
+			MCAgent* challenger = makeAgent(MCAgent::LeafMode(m));
+			MCAgent* rollout = makeAgent(MCAgent::ROLLOUT);
+
+			for(MCAgent* a : { challenger, rollout }) {
+				a->useIterations() = false;
+				a->timePerMove() = timePerMove;
+			}
+
+			// Take turns going first, Game owns the agents
+			bool first = i % 2 == 0;
+			Game g(first ? challenger : rollout, first ? rollout : challenger);
+			g.reset();
+			g.playAll();
+
+			int diff = first ? g.scoreDifference() : -g.scoreDifference();
+			if(diff > 0)      won++;
+			else if(diff < 0) lost++;
+			else              drawn++;
+		}
+
+		std::cout << names[m] << " vs rollout at " << timePerMove << "s per move: "
+		          << won << " won, " << lost << " lost, " << drawn << " drawn" << std::endl;
+	}
+
+	return 0;
+}
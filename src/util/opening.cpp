@@ -1,34 +1,36 @@
 #include <mancala/Board.hpp>
 #include <mancala/MCAgent.hpp>
-
+#include <mancala/Book.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <iterator>
 #include <fstream>
+#include <string>
 #include <utility>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 
-namespace std {
-
-template<> struct hash<std::pair<Board, Side>> {
-	typedef std::pair<Board, Side> argument_type;
-	typedef std::size_t result_type;
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-	result_type operator()(const argument_type& b) const {
-		std::hash<Board> k;
-		std::hash<int> kk;
-		size_t h = k(b.first);
-		h = kk(int(b.second)) + 0x9e3779b9 + (h<<6) + (h>>2);
-		return h;
-	}
-};
+// Every table here is keyed by canonical boards, a leaf that both sides can
+// reach is only evaluated once
 
-}
+// Extra turns let many move sequences transpose into the same leaf, this
+// counts how many reach each one
+typedef std::unordered_map<Board, size_t> LeafMap;
 
-void gen_positions_split(size_t depth, Side whosTurn, const Board& b, std::vector<Board>& sb, std::vector<Board>& nb) {
+void gen_positions(size_t depth, Side whosTurn, const Board& b, LeafMap& leaves) {
 	if(depth == 0) {
-		if(whosTurn == SOUTH) sb.push_back(b);
-		else                  nb.push_back(b);
-
+		leaves[canonical(b, whosTurn)]++;
 		return;
 	}
 
@@ -40,26 +42,29 @@ void gen_positions_split(size_t depth, Side whosTurn, const Board& b, std::vecto
 		Board tmp = b;
 		bool again = tmp.makeMove(whosTurn, moves[i]);
 
-		gen_positions_split(depth - 1, (again && !firstMove) ? whosTurn : (Side)(((int)whosTurn)^1), tmp, sb, nb);
+		gen_positions(depth - 1, (again && !firstMove) ? whosTurn : (Side)(((int)whosTurn)^1), tmp, leaves);
 	}
 }
 
 typedef std::unordered_map<Board, float> ValMap;
 typedef std::unordered_map<Board, uint8_t> MoveMap;
-std::pair<float, float> fillBook(const Board& pos, Side cur, size_t depthLeft, ValMap& sVals, ValMap& nVals, MoveMap& sMoves, MoveMap& noMoves) {
+typedef std::unordered_map<Board, size_t> DepthMap;
+// Values are for the side to move. searched remembers how deep each interior
+// node went, a transposition that is searched as deep again is already in
+// vals.
+std::pair<float, float> fillBook(const Board& pos, Side cur, size_t depthLeft, ValMap& vals, MoveMap& bookMoves, DepthMap& searched) {
+	const Board key = canonical(pos, cur);
+
+	auto it = searched.find(key);
+	if(depthLeft == 0 || (it != searched.end() && it->second == depthLeft)) {
+		float val = vals[key];
+		if(cur == SOUTH) return std::make_pair(val, 1.0 - val);
+		else             return std::make_pair(1.0 - val, val);
+	}
+
 	size_t nMoves;
 	const auto* moves = pos.validMoves(cur, nMoves);
 
-	if(depthLeft == 0) {
-		if(cur == SOUTH) {
-			float val = sVals[pos];
-			return std::make_pair(val, 1.0 - val);
-		}  else {
-			float val = nVals[pos];
-			return std::make_pair(1.0 - val, val);
-		}
-	}
-
 	bool firstMove = (cur == SOUTH) && (pos.stonesInWell(SOUTH) == 0);
 	
 	uint8_t bestMove = moves[0];
@@ -69,7 +74,7 @@ std::pair<float, float> fillBook(const Board& pos, Side cur, size_t depthLeft, V
 	for(size_t i = 0; i < nMoves; i++) {
 		Board cpy = pos;
 		bool ga = cpy.makeMove(cur, moves[i]);
-		auto res = fillBook(cpy, (!firstMove && ga) ? cur : Side(int(cur)^1), depthLeft - 1, sVals, nVals, sMoves, noMoves);
+		auto res = fillBook(cpy, (!firstMove && ga) ? cur : Side(int(cur)^1), depthLeft - 1, vals, bookMoves, searched);
 
 		float scores[2] = { res.first, res.second };
 		float ours = scores[int(cur)];
@@ -81,122 +86,604 @@ std::pair<float, float> fillBook(const Board& pos, Side cur, size_t depthLeft, V
 		}
 	}
 
-	if(cur == SOUTH) {
-		sVals[pos] = bestVal;
-		sMoves[pos] = bestMove;
-	} else {
-		nVals[pos] = bestVal;
-		noMoves[pos] = bestMove;
-	}
+	vals[key] = bestVal;
+	bookMoves[key] = bestMove;
+	searched[key] = depthLeft;
 
 	return bestRes;
 }
 
-int main() {
-	const size_t depth = 4;
+// What a leaf gets when it is searched in one go. The single process mode
+// works up to it in ROUNDS rounds of longer and longer searches, FULL is the
+// round of a LEAF_TIME one.
+static const double LEAF_TIME = 20.0;
+static const size_t ROUNDS = 4;
+static const size_t FULL = ROUNDS - 1;
+
+// Every search of a leaf gets appended to a journal as it comes in, so a run
+// that gets killed only loses the searches that were running. A record is a
+// leaf's Book key, the round of the search and its value as little endian
+// float bits. No search is run twice. A FULL one is a final value wherever
+// the position isn't a leaf going through the rounds, in a deeper book's
+// tree say, a leaf going through them replays every round it has.
+static const char JOURNAL_MAGIC[4] = { 'M', 'K', 'J', '2' };
+static const size_t RECORD_BYTES = Book::KEY_BYTES + 5;
+
+/// What each round's search of a leaf said
+struct Searches {
+	float found[ROUNDS];
+	// Bit r is set once round r has been searched
+	uint8_t done = 0;
+};
+typedef std::unordered_map<Board, Searches> SearchMap;
+
+/// Loads what an earlier run searched. Returns false if the file isn't a
+/// journal.
+static bool readJournal(const std::string& path, SearchMap& searches, bool& exists) {
+	std::ifstream in(path, std::ios::binary);
+	std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	exists = !bytes.empty();
+	if(!exists) return true;
+	if(bytes.size() < sizeof(JOURNAL_MAGIC) || memcmp(bytes.data(), JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0) return false;
+
+	size_t records = (bytes.size() - sizeof(JOURNAL_MAGIC)) / RECORD_BYTES;
+	for(size_t i = 0; i < records; i++) {
+		const uint8_t* r = bytes.data() + sizeof(JOURNAL_MAGIC) + i * RECORD_BYTES;
+
+		const size_t round = r[Book::KEY_BYTES];
+		if(round >= ROUNDS) return false;
+
+		uint32_t bits = 0;
+		for(size_t j = 0; j < 4; j++) bits |= uint32_t(r[Book::KEY_BYTES + 1 + j]) << (8 * j);
+
+		Searches& s = searches[Book::board(r)];
+		memcpy(&s.found[round], &bits, sizeof(bits));
+		s.done |= 1 << round;
+	}
+
+	// Drop a record that was cut off halfway, appending after it would
+	// throw every later one out of line
+	size_t whole = sizeof(JOURNAL_MAGIC) + records * RECORD_BYTES;
+	if(whole != bytes.size() && truncate(path.c_str(), whole) != 0) return false;
+
+	return true;
+}
+
+static void appendJournal(std::ofstream& journal, const Board& leaf, size_t round, float val) {
+	uint8_t r[RECORD_BYTES];
+	Book::key(leaf, r);
+	r[Book::KEY_BYTES] = uint8_t(round);
+
+	uint32_t bits;
+	memcpy(&bits, &val, sizeof(bits));
+	for(size_t j = 0; j < 4; j++) r[Book::KEY_BYTES + 1 + j] = uint8_t(bits >> (8 * j));
+
+	journal.write((const char*)r, RECORD_BYTES);
+	journal.flush();
+}
+
+/// The values of the leaves that have had a FULL search
+static void finals(const SearchMap& searches, ValMap& vals) {
+	for(const auto& s : searches) {
+		if(s.second.done & 1 << FULL) vals[s.first] = s.second.found[FULL];
+	}
+}
+
+static float evaluate(const Board& leaf, double seconds) {
+	MCAgent gg;
+	gg.timePerMove() = seconds;
+	gg.useIterations() = false;
+	return gg.makeMoveAndScore(leaf, SOUTH, 10, 0).second;
+}
+
+static size_t sequences(const LeafMap& leaves) {
+	size_t n = 0;
+	for(const auto& leaf : leaves) n += leaf.second;
+	return n;
+}
+
+/// Searches every leaf, journaling each value as it comes in
+static void evaluateAll(const std::vector<Board>& leaves, std::ofstream& journal, ValMap& vals) {
+	size_t done = 0;
+
+	#pragma omp parallel for schedule(dynamic)
+	for(size_t i = 0; i < leaves.size(); i++) {
+		float val = evaluate(leaves[i], LEAF_TIME);
+
+		#pragma omp critical(journal)
+		{
+			appendJournal(journal, leaves[i], FULL, val);
+			vals[leaves[i]] = val;
+
+			if(++done % 16 == 0) std::cout << "Calculated values for " << 100.0 * float(done)/leaves.size() << "% of leaves" << std::endl;
+		}
+	}
+}
+
+// Most leaves don't need the full LEAF_TIME. The single process mode hands
+// out time in ROUNDS rounds, each four times as long as the one before and
+// the FULL one LEAF_TIME, so a leaf that needs all of them costs 85/64 of a
+// flat search. On average the change from the search before is about as big
+// as the error left. Longer searches drift the same way for every leaf, so a
+// leaf's value is its latest search plus the mean change of its round. Each
+// leaf's own change is all over the place, so its interval is twice the
+// bigger of its own change and the spread of the changes in its round.
+//
+// Those intervals get backed up through the book tree. A leaf only gets
+// another round while its interval is wider than TOLERANCE and some book
+// position could still choose a move more than TOLERANCE worse because of
+// it. Opening values all sit close to 0.5, so that has to be small.
+static const float TOLERANCE = 0.0025;
+
+struct Estimate {
+	float val;
+	float halfWidth;
+	// What the last search said, val has the drift expected from here on
+	float last;
+};
+typedef std::unordered_map<Board, Estimate> EstMap;
 
+// Lowest and highest value for the side to move
+typedef std::pair<float, float> Interval;
+typedef std::unordered_map<Board, std::pair<size_t, Interval>> IntervalMap;
+
+static Interval bounds(const Board& pos, Side cur, size_t depthLeft, const EstMap& est, IntervalMap& memo) {
+	const Board key = canonical(pos, cur);
+
+	if(depthLeft == 0) {
+		const Estimate& e = est.at(key);
+		return Interval(std::max(0.0f, e.val - e.halfWidth), std::min(1.0f, e.val + e.halfWidth));
+	}
+
+	auto it = memo.find(key);
+	if(it != memo.end() && it->second.first == depthLeft) return it->second.second;
+
+	size_t nMoves;
+	const auto* moves = pos.validMoves(cur, nMoves);
+	bool firstMove = (cur == SOUTH) && (pos.stonesInWell(SOUTH) == 0);
+
+	Interval res(0.0f, 0.0f);
+	for(size_t i = 0; i < nMoves; i++) {
+		Board cpy = pos;
+		bool ga = cpy.makeMove(cur, moves[i]);
+		Side next = (!firstMove && ga) ? cur : Side(int(cur)^1);
+
+		Interval c = bounds(cpy, next, depthLeft - 1, est, memo);
+		if(next != cur) c = Interval(1.0f - c.second, 1.0f - c.first);
+
+		res.first = std::max(res.first, c.first);
+		res.second = std::max(res.second, c.second);
+	}
+
+	memo[key] = std::make_pair(depthLeft, res);
+	return res;
+}
+
+/// Finds the leaves whose value still matters. A move is still in the running
+/// if it could beat the surest one by more than TOLERANCE. A position's value
+/// matters if it is one of several moves still in the running, or the only
+/// one and the position before matters.
+static void contested(const Board& pos, Side cur, size_t depthLeft, bool matters, const EstMap& est,
+                      IntervalMap& memo, DepthMap& visited, std::unordered_set<Board>& leaves) {
+	const Board key = canonical(pos, cur);
+
+	if(depthLeft == 0) {
+		if(matters) leaves.insert(key);
+		return;
+	}
+
+	// The same position is searched alike from everywhere, it only has to
+	// be visited again if its value matters now and didn't before
+	auto it = visited.find(key);
+	size_t mark = 2 * depthLeft + matters;
+	if(it != visited.end() && it->second / 2 == depthLeft && it->second >= mark) return;
+	visited[key] = mark;
+
+	size_t nMoves;
+	const auto* moves = pos.validMoves(cur, nMoves);
+	bool firstMove = (cur == SOUTH) && (pos.stonesInWell(SOUTH) == 0);
+
+	Board children[7];
+	Side sides[7];
+	Interval vals[7];
+	size_t best = 0;
+
+	for(size_t i = 0; i < nMoves; i++) {
+		children[i] = pos;
+		bool ga = children[i].makeMove(cur, moves[i]);
+		sides[i] = (!firstMove && ga) ? cur : Side(int(cur)^1);
+
+		vals[i] = bounds(children[i], sides[i], depthLeft - 1, est, memo);
+		if(sides[i] != cur) vals[i] = Interval(1.0f - vals[i].second, 1.0f - vals[i].first);
+
+		if(vals[i].first > vals[best].first) best = i;
+	}
+
+	bool candidate[7];
+	size_t candidates = 0;
+	for(size_t i = 0; i < nMoves; i++) {
+		candidate[i] = i == best || vals[i].second > vals[best].first + TOLERANCE;
+		candidates += candidate[i];
+	}
+
+	// Every position is in the book, so the ones under a move that has
+	// already lost still choose their own moves
+	for(size_t i = 0; i < nMoves; i++) {
+		contested(children[i], sides[i], depthLeft - 1, candidate[i] && (matters || candidates > 1), est, memo, visited, leaves);
+	}
+}
+
+/// Searches the leaves in rounds, journaling every search as it comes in.
+/// A search the journal already has isn't run again but still counts in its
+/// round, so a resumed run replays the rounds the killed one got through and
+/// goes on from there. Positions in vals that aren't in leaves are taken as
+/// exact.
+static void evaluateRounds(size_t depth, const std::vector<Board>& leaves, std::ofstream& journal, SearchMap& searches,
+                           ValMap& vals) {
 	Board b;
 	b.reset();
-	
-	std::vector<Board> northLeaves;
-	std::vector<Board> southLeaves;
-	gen_positions_split(depth, SOUTH, b, southLeaves, northLeaves);
-	std::vector<float> northValues(northLeaves.size());
-	std::vector<float> southValues(southLeaves.size());
-
-	std::cout << southLeaves.size() << " initial south leaves at depth " << depth << std::endl;
-	std::cout << northLeaves.size() << " initial north leaves at depth " << depth << std::endl;
-	std::cout << std::endl;
 
-	#pragma omp parallel for schedule(dynamic)
-	for(size_t i = 0; i < southLeaves.size(); i++) {
-		MCAgent gg;
-		gg.timePerMove() = 20.0;
-		gg.useIterations() = false;
-		southValues[i] = gg.makeMoveAndScore(southLeaves[i], SOUTH, 10, 0).second;
+	// The leaves get theirs from round 0 on
+	EstMap est;
+	for(const auto& v : vals) est[v.first] = Estimate{ v.second, 0.0f, v.second };
+
+	std::vector<Board> active = leaves;
+	double cpu = 0.0;
+
+	for(size_t round = 0; round < ROUNDS && !active.empty(); round++) {
+		const double seconds = LEAF_TIME / double(1 << 2 * (FULL - round));
+
+		std::vector<Board> todo;
+		for(const Board& leaf : active) {
+			if(!(searches[leaf].done & 1 << round)) todo.push_back(leaf);
+		}
+		std::cout << "Round " << round + 1 << ": searching " << todo.size() << " of " << active.size()
+		          << " leaves for " << seconds << "s, the journal has the rest" << std::endl;
+
+		#pragma omp parallel for schedule(dynamic)
+		for(size_t i = 0; i < todo.size(); i++) {
+			float val = evaluate(todo[i], seconds);
+
+			#pragma omp critical(journal)
+			{
+				appendJournal(journal, todo[i], round, val);
+				Searches& s = searches[todo[i]];
+				s.found[round] = val;
+				s.done |= 1 << round;
+			}
+		}
+		cpu += seconds * todo.size();
+
+		std::vector<float> found(active.size());
+		for(size_t i = 0; i < active.size(); i++) found[i] = searches[active[i]].found[round];
+
+		// Nothing is known about the error of the first search
+		double sum = 0.0, squares = 0.0;
+		for(size_t i = 0; round > 0 && i < active.size(); i++) {
+			double change = found[i] - est[active[i]].last;
+			sum += change;
+			squares += change * change;
+		}
+		float drift = round < FULL ? sum / active.size() : 0.0f;
+		float spread = std::sqrt(std::max(0.0, squares / active.size() - (sum / active.size()) * (sum / active.size())));
+
+		for(size_t i = 0; i < active.size(); i++) {
+			float change = std::abs(found[i] - est[active[i]].last - float(sum / active.size()));
+			est[active[i]] = Estimate{ found[i] + drift, round == 0 ? 1.0f : 2.0f * std::max(change, spread), found[i] };
+		}
 
-		if(i % 16 == 0) std::cout << "Calculated values for " << 100.0 * float(i)/southLeaves.size() << "% of south leaves" << std::endl;
+		std::unordered_set<Board> open;
+		if(round < FULL) {
+			IntervalMap memo;
+			DepthMap visited;
+			contested(b, SOUTH, depth, false, est, memo, visited, open);
+		}
+
+		std::vector<Board> next;
+		for(const Board& leaf : active) {
+			const Estimate& e = est[leaf];
+			if(open.count(leaf) && e.halfWidth > TOLERANCE) {
+				next.push_back(leaf);
+			} else {
+				vals[leaf] = e.val;
+			}
+		}
+
+		std::cout << "Settled " << active.size() - next.size() << " leaves, " << next.size() << " still open" << std::endl;
+		active.swap(next);
 	}
 
-	std::cout << "Done calculating values for south leaves\n" << std::endl;
+	std::cout << "Searched for " << cpu << " CPU seconds, " << LEAF_TIME * leaves.size()
+	          << " with a flat " << LEAF_TIME << "s per leaf" << std::endl;
+}
 
-	#pragma omp parallel for schedule(dynamic)
-	for(size_t i = 0; i < northLeaves.size(); i++) {
-		MCAgent gg;
-		gg.timePerMove() = 20.0;
-		gg.useIterations() = false;
-		northValues[i] = gg.makeMoveAndScore(northLeaves[i], NORTH, 10, 0).second;
-		
-		if(i % 16 == 0) std::cout << "Calculated values for " << 100.0 * float(i)/northLeaves.size() << "% of north leaves" << std::endl;
+/// Backs the leaf values up to the root and writes book.bin, with the value
+/// of every position in it
+static void writeBooks(size_t depth, ValMap& vals) {
+	Board b;
+	b.reset();
+
+	MoveMap bookMoves;
+	DepthMap searched;
+	fillBook(b, SOUTH, depth, vals, bookMoves, searched);
+
+	std::cout << "Done filling book\n" << std::endl;
+
+	std::vector<std::pair<Board, uint8_t>> entries(bookMoves.begin(), bookMoves.end());
+	std::vector<float> values;
+	for(const auto& e : entries) values.push_back(vals[e.first]);
+
+	auto bytes = Book::encode(entries, values);
+	std::ofstream out("book.bin", std::ios::binary);
+	out.write((const char*)bytes.data(), bytes.size());
+
+	std::cout << "Saved " << entries.size() << " entries" << std::endl;
+}
+
+// Sharded runs share nothing but a directory, which can sit on a network
+// filesystem so workers on several hosts can help:
+//
+//     todo/   shards nobody has claimed yet
+//     taken/  claimed shards, each next to the journal of its results so far
+//     done/   finished journals
+//
+// A worker claims a shard by renaming it from todo/ to taken/. Only one
+// rename of the same file can succeed, so no two workers ever search the
+// same shard. A shard is "MKS1" followed by the Book keys of its leaves.
+// If a worker dies, moving its shard back to todo/ lets the next one pick
+// up where its journal stops.
+static const char SHARD_MAGIC[4] = { 'M', 'K', 'S', '1' };
+
+static std::vector<std::string> listDir(const std::string& dir) {
+	std::vector<std::string> names;
+
+	DIR* d = opendir(dir.c_str());
+	if(!d) return names;
+	while(dirent* e = readdir(d)) {
+		if(e->d_name[0] != '.') names.push_back(e->d_name);
+	}
+	closedir(d);
+
+	return names;
+}
+
+static bool readShard(const std::string& path, std::vector<Board>& leaves) {
+	std::ifstream in(path, std::ios::binary);
+	std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	if(bytes.size() < sizeof(SHARD_MAGIC) || memcmp(bytes.data(), SHARD_MAGIC, sizeof(SHARD_MAGIC)) != 0) return false;
+	if((bytes.size() - sizeof(SHARD_MAGIC)) % Book::KEY_BYTES != 0) return false;
+
+	for(size_t at = sizeof(SHARD_MAGIC); at < bytes.size(); at += Book::KEY_BYTES) {
+		leaves.push_back(Book::board(bytes.data() + at));
+	}
+
+	return true;
+}
+
+/// Loads every finished shard's results
+static bool readDone(const std::string& dir, ValMap& vals) {
+	SearchMap searches;
+	for(const std::string& name : listDir(dir + "/done")) {
+		bool exists;
+		if(!readJournal(dir + "/done/" + name, searches, exists)) {
+			std::cerr << dir << "/done/" << name << " is not a journal" << std::endl;
+			return false;
+		}
+	}
+
+	finals(searches, vals);
+	return true;
+}
+
+// usage: opening split <depth> <dir> [leaves per shard]
+//
+// Leaves that already have a value in done/ aren't queued again, so a
+// deeper split into the same directory only adds the new ones. It has to
+// wait for the queue to drain, leaves still in todo/ or taken/ would
+// otherwise be queued twice.
+static int split(size_t depth, const std::string& dir, size_t perShard) {
+	for(const char* sub : { "", "/todo", "/taken", "/done" }) {
+		if(mkdir((dir + sub).c_str(), 0777) != 0 && errno != EEXIST) {
+			std::cerr << "Could not create " << dir << sub << std::endl;
+			return 1;
+		}
+	}
+
+	for(const char* sub : { "/todo", "/taken" }) {
+		if(!listDir(dir + sub).empty()) {
+			std::cerr << dir << sub << " isn't empty, let the workers finish before splitting again" << std::endl;
+			return 1;
+		}
 	}
 
-	std::cout << "Done calculating values for north leaves\n" << std::endl;
+	ValMap vals;
+	if(!readDone(dir, vals)) return 1;
 
-	std::unordered_map<Board, float> southMap;
-	std::unordered_map<Board, float> northMap;
+	Board b;
+	b.reset();
+	LeafMap leafSet;
+	gen_positions(depth, SOUTH, b, leafSet);
 
-	for(size_t i = 0; i < southLeaves.size(); i++) {
-		southMap[southLeaves[i]] = southValues[i];
+	std::vector<Board> leaves;
+	for(const auto& leaf : leafSet) {
+		if(vals.find(leaf.first) == vals.end()) leaves.push_back(leaf.first);
 	}
 
-	for(size_t i = 0; i < northLeaves.size(); i++) {
-		northMap[northLeaves[i]] = northValues[i];
+	size_t shards = 0;
+	for(size_t first = 0; first < leaves.size(); first += perShard, shards++) {
+		char name[32];
+		snprintf(name, sizeof(name), "d%zu-%06zu", depth, shards);
+
+		// Written next to the queue and renamed in, workers never see half a shard
+		std::string tmp = dir + "/." + name;
+		std::ofstream out(tmp, std::ios::binary);
+		out.write(SHARD_MAGIC, sizeof(SHARD_MAGIC));
+		for(size_t i = first; i < std::min(first + perShard, leaves.size()); i++) {
+			uint8_t k[Book::KEY_BYTES];
+			Book::key(leaves[i], k);
+			out.write((const char*)k, sizeof(k));
+		}
+		out.close();
+
+		if(!out || rename(tmp.c_str(), (dir + "/todo/" + name).c_str()) != 0) {
+			std::cerr << "Could not queue " << name << std::endl;
+			return 1;
+		}
+	}
+
+	std::cout << leafSet.size() << " initial leaves at depth " << depth << " (" << sequences(leafSet) << " move sequences), "
+	          << leafSet.size() - leaves.size() << " of them already done, queued the rest in "
+	          << shards << " shards" << std::endl;
+
+	return 0;
+}
+
+// usage: opening work <dir>
+//
+// Claims and searches shards until there are none left to claim.
+static int work(const std::string& dir) {
+	size_t finished = 0;
+
+	for(;;) {
+		std::string name;
+		for(const std::string& n : listDir(dir + "/todo")) {
+			if(rename((dir + "/todo/" + n).c_str(), (dir + "/taken/" + n).c_str()) == 0) {
+				name = n;
+				break;
+			}
+		}
+		if(name.empty()) break;
+
+		const std::string shardPath = dir + "/taken/" + name;
+		const std::string journalPath = shardPath + ".journal";
+
+		std::vector<Board> shard;
+		if(!readShard(shardPath, shard)) {
+			std::cerr << shardPath << " is not a shard" << std::endl;
+			return 1;
+		}
+
+		SearchMap searches;
+		bool resumed;
+		if(!readJournal(journalPath, searches, resumed)) {
+			std::cerr << journalPath << " is not a journal" << std::endl;
+			return 1;
+		}
+
+		ValMap vals;
+		finals(searches, vals);
+
+		std::ofstream journal(journalPath, std::ios::binary | std::ios::app);
+		if(!resumed) journal.write(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+
+		std::vector<Board> leaves;
+		for(const Board& leaf : shard) {
+			if(vals.find(leaf) == vals.end()) leaves.push_back(leaf);
+		}
+
+		std::cout << "Claimed " << name << ", " << leaves.size() << " of its " << shard.size() << " leaves left" << std::endl;
+		evaluateAll(leaves, journal, vals);
+		journal.close();
+
+		if(!journal || rename(journalPath.c_str(), (dir + "/done/" + name).c_str()) != 0) {
+			std::cerr << "Could not finish " << name << std::endl;
+			return 1;
+		}
+		unlink(shardPath.c_str());
+		finished++;
 	}
 
-	std::cout << "Done inserting values into map" << std::endl;
+	std::cout << "No shards left, finished " << finished << std::endl;
 
-	std::unordered_map<Board, uint8_t> southFin;
-	std::unordered_map<Board, uint8_t> northFin;
-	fillBook(b, SOUTH, depth, southMap, northMap, southFin, northFin);
+	return 0;
+}
 
-	std::cout << "Done filling books\n" << std::endl;
+// usage: opening merge <depth> <dir>
+static int merge(size_t depth, const std::string& dir) {
+	ValMap vals;
+	if(!readDone(dir, vals)) return 1;
 
-	std::fstream nOut;
-	nOut.open("nbook.bin", std::ios::out);
-	std::fstream sOut;
-	sOut.open("sbook.bin", std::ios::out);
+	Board b;
+	b.reset();
+	LeafMap leafSet;
+	gen_positions(depth, SOUTH, b, leafSet);
 
-	std::fstream nVOut;
-	nVOut.open("nvbook.bin", std::ios::out);
-	std::fstream sVOut;
-	sVOut.open("svbook.bin", std::ios::out);
+	size_t missing = 0;
+	for(const auto& leaf : leafSet) {
+		if(vals.find(leaf.first) == vals.end()) missing++;
+	}
 
-	// This will break on big endian systems #YOLO
-	uint32_t sSize = southFin.size();
-	sOut.write((char*)&sSize, sizeof(uint32_t));
-	for(const auto& entry : southFin) {
-		sOut.write((char*)&entry.first, 16);
-		sOut.write((char*)&entry.second, 1);
+	if(missing != 0) {
+		std::cerr << missing << " of " << leafSet.size() << " leaves at depth " << depth
+		          << " have no value yet, are all shards done?" << std::endl;
+		return 1;
 	}
 
-	std::cout << "Saved " << sSize << " entries for south" << std::endl;
+	std::cout << "Merging " << vals.size() << " leaf values from " << dir << std::endl;
+	writeBooks(depth, vals);
+
+	return 0;
+}
 
-	uint32_t nSize = northFin.size();
-	nOut.write((char*)&nSize, sizeof(uint32_t));
-	for(const auto& entry : northFin) {
-		nOut.write((char*)&entry.first, 16);
-		nOut.write((char*)&entry.second, 1);
+// usage: opening [depth] [journal]
+//        opening split <depth> <dir> [leaves per shard]
+//        opening work <dir>
+//        opening merge <depth> <dir>
+int main(int argc, char** argv) {
+	const std::string mode = argc > 1 ? argv[1] : "";
+
+	if(mode == "split" && (argc == 4 || argc == 5)) return split(atoi(argv[2]), argv[3], argc == 5 ? std::max(1, atoi(argv[4])) : 64);
+	if(mode == "work" && argc == 3) return work(argv[2]);
+	if(mode == "merge" && argc == 4) return merge(atoi(argv[2]), argv[3]);
+	if(mode == "split" || mode == "work" || mode == "merge") {
+		std::cerr << "usage: opening split <depth> <dir> [leaves per shard]\n"
+		          << "       opening work <dir>\n"
+		          << "       opening merge <depth> <dir>" << std::endl;
+		return 1;
 	}
 
-	std::cout << "Saved " << nSize << " entries for north\n" << std::endl;
+	const size_t depth = argc > 1 ? atoi(argv[1]) : 4;
+	const std::string journalPath = argc > 2 ? argv[2] : "opening.journal";
 
-	sSize = southMap.size();
-	sVOut.write((char*)&sSize, sizeof(uint32_t));
-	for(const auto& entry : southMap) {
-		sVOut.write((char*)&entry.first, 16);
-		sVOut.write((char*)&entry.second, sizeof(float));
+	Board b;
+	b.reset();
+
+	SearchMap searches;
+	bool resumed;
+	if(!readJournal(journalPath, searches, resumed)) {
+		std::cerr << journalPath << " is not a journal" << std::endl;
+		return 1;
 	}
 
-	std::cout << "Saved " << sSize << " values for south" << std::endl;
+	ValMap vals;
+	finals(searches, vals);
 
-	nSize = northMap.size();
-	nVOut.write((char*)&nSize, sizeof(uint32_t));
-	for(const auto& entry : northMap) {
-		nVOut.write((char*)&entry.first, 16);
-		nVOut.write((char*)&entry.second, sizeof(float));
+	std::ofstream journal(journalPath, std::ios::binary | std::ios::app);
+	if(!resumed) journal.write(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+
+	LeafMap leafSet;
+	gen_positions(depth, SOUTH, b, leafSet);
+
+	// Leaves searched in one go, by a sharded run, have no rounds to replay
+	// and keep their value. Every other one goes through the rounds again,
+	// the journal has whatever they already searched.
+	std::vector<Board> leaves;
+	for(const auto& leaf : leafSet) {
+		auto s = searches.find(leaf.first);
+		if(s == searches.end() || s->second.done != 1 << FULL) leaves.push_back(leaf.first);
 	}
 
-	std::cout << "Saved " << nSize << " values for north" << std::endl;
-	
+	std::cout << leafSet.size() << " initial leaves at depth " << depth << " (" << sequences(leafSet) << " move sequences), "
+	          << leafSet.size() - leaves.size() << " of them searched in one go in " << journalPath << std::endl;
+	std::cout << std::endl;
+
+	evaluateRounds(depth, leaves, journal, searches, vals);
+
+	std::cout << "Done calculating values for leaves\n" << std::endl;
+
+	writeBooks(depth, vals);
+
 	return 0;
 }
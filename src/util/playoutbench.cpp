@@ -0,0 +1,49 @@
+#include <mancala/Board.hpp>
+#include <mancala/playout.hpp>
+#include <mancala/batchplayout.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <tuple>
+
+typedef std::tuple<uint32_t, uint32_t> (*Playouts)(const Board&, Side, size_t);
+
+// Single threaded, so this is games per second per core
+static double gamesPerSec(Playouts f, const Board& b, Side toMove, size_t games) {
+	using namespace std::chrono;
+
+	auto before = high_resolution_clock::now();
+	auto res = f(b, toMove, games);
+	auto after = high_resolution_clock::now();
+
+	// Keep the result alive
+	if(std::get<0>(res) + std::get<1>(res) != 2 * games) std::cerr << "Lost some games!" << std::endl;
+
+	return games / duration_cast<duration<double>>(after - before).count();
+}
+
+int main() {
+	const size_t games = 2000000;
+
+	Board positions[3];
+	positions[0].reset();
+	positions[1] = positions[0];
+	positions[1].makeMove(SOUTH, 3);
+	positions[1].makeMove(NORTH, 0);
+	positions[2] = positions[1];
+	positions[2].makeMove(SOUTH, 6);
+	positions[2].makeMove(NORTH, 5);
+
+	Side toMove[3] = { SOUTH, SOUTH, SOUTH };
+	const char* names[3] = { "opening", "2 plies", "4 plies" };
+
+	for(size_t i = 0; i < 3; i++) {
+		double scalar = gamesPerSec(playout::randomPlayouts, positions[i], toMove[i], games);
+		double batch = gamesPerSec(playout::batchPlayouts, positions[i], toMove[i], games);
+
+		std::cout << names[i] << ": scalar " << scalar << " games/s, batched " << batch << " games/s"
+		          << " (" << batch / scalar << "x)" << std::endl;
+	}
+
+	return 0;
+}
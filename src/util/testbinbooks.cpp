@@ -1,20 +1,16 @@
-#include <mancala/binutils.hpp>
+#include <mancala/Book.hpp>
 
 #include <iostream>
-#include <fstream>
 
+// Looks up north's answers to every first move in the book opening writes.
+// It is keyed by canonical boards.
 int main() {
-	std::fstream sbook, nbook, svbook, nvbook;
-	sbook.open("sbook.bin", std::ios_base::in);
-	nbook.open("nbook.bin", std::ios_base::in);
-	svbook.open("svbook.bin", std::ios_base::in);
-	nvbook.open("nvbook.bin", std::ios_base::in);
+	Book book = Book::open("book.bin");
 
-	auto sb = binutils::readBook(sbook);
-	auto nb = binutils::readBook(nbook);
-
-	auto svb = binutils::readVBook(svbook);
-	auto nvb = binutils::readVBook(nvbook);
+	if(!book.verify()) {
+		std::cout << "Book is missing or corrupt" << std::endl;
+		return 1;
+	}
 
 	Board b;
 	b.reset();
@@ -22,23 +18,23 @@ int main() {
 	for(uint8_t i = 0; i < 7; i++) {
 		Board cpy = b;
 		cpy.makeMove(SOUTH, i);
+		Board key = canonical(cpy, NORTH);
 
-		auto it = nb.find(cpy);
-		if(it != nb.end()) {
-			std::cout << "When south makes " << int(i) << " north responds with " << int(it->second) << std::endl;
+		uint8_t move = book.find(key);
+		if(move != Book::NO_MOVE) {
+			std::cout << "When south makes " << int(i) << " north responds with " << int(move) << std::endl;
 		} else {
 			std::cout << "Could not find entry for " << int(i) << std::endl;
 		}
 
-		auto vit = nvb.find(cpy);
-		if(vit != nvb.end())
-			std::cout << "When south makes " << int(i) << " north has value " << vit->second << std::endl;
+		float value = book.value(key);
+		if(value != Book::NO_VALUE)
+			std::cout << "When south makes " << int(i) << " north has value " << value << std::endl;
 		else
 			std::cout << "Could not find value for " << int(i) << std::endl;
 	}
 
-	std::cout << "Book sizes = (" << sb.size() << ", " << nb.size() << ")" << std::endl;
-	std::cout << "Value sizes = (" << svb.size() << ", " << nvb.size() << ")" << std::endl;
+	std::cout << "Book size = " << book.size() << std::endl;
 
 	return 0;
 }
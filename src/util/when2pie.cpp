@@ -1,11 +1,13 @@
 #include <mancala/Board.hpp>
 #include <mancala/Game.hpp>
 #include <mancala/MCAgent.hpp>
+#include <mancala/batchplayout.hpp>
 
 #include <iostream>
 
 constexpr uint64_t GAMES_PER_CHUNK = 1ull;
 constexpr uint64_t CHUNKS_PER_MOVE = 4ull;
+constexpr uint64_t RANDOM_GAMES_PER_MOVE = 1000000ull;
 
 static thread_local Game g(new MCAgent(), new MCAgent());
 
@@ -58,6 +60,24 @@ int main() {
 		std::cout << "DONE WITH POSITION " << i << std::endl;
 	}
 
+	// Pure random playouts as a baseline, these are cheap enough to run lots of
+	uint64_t southRandom[7] = { 0 };
+	uint64_t northRandom[7] = { 0 };
+
+	#pragma omp parallel for schedule(dynamic)
+	for(size_t i = 0; i < 7; i++) {
+		auto res = playout::batchPlayouts(boards[i], NORTH, RANDOM_GAMES_PER_MOVE);
+		southRandom[i] = std::get<0>(res);
+		northRandom[i] = std::get<1>(res);
+	}
+
+	for(size_t i = 0; i < 7; i++) {
+		std::cout << "When first move is " << i << " random playouts give "
+		          << "SOUTH=" << southRandom[i]/2.0 << " NORTH=" << northRandom[i]/2.0
+		          << " DIFF=" << (((double)southRandom[i] - (double)northRandom[i])/(2.0 * RANDOM_GAMES_PER_MOVE))
+		          << std::endl;
+	}
+
 	for(size_t i = 0; i < 7; i++) {
 		std::cout << "When first move is " << i << " "
 		          << "SOUTH=" << southWins[i]/2.0 << " NORTH=" << northWins[i]/2.0
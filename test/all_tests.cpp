@@ -3,6 +3,12 @@
 #include "board_tests.cpp"
 #include "game_tests.cpp"
 #include "io_tests.cpp"
+#include "playout_tests.cpp"
+#include "mcagent_tests.cpp"
+#include "savageagent_tests.cpp"
+#include "threadpool_tests.cpp"
+#include "clock_tests.cpp"
+#include "book_tests.cpp"
 
 int main(int argc, char** argv) {
 	testing::InitGoogleTest(&argc, argv);
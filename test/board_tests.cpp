@@ -318,3 +318,32 @@ TEST(Board, NotACapture) {
 
 	EXPECT_EQ(0u, b.stonesInWell(SOUTH));
 }
+
+TEST(Board, Mirrored) {
+	Board b;
+	b.reset();
+	Board m = b.mirrored();
+	EXPECT_TRUE(b == m);
+
+	// Playing the same holes for the other side keeps the boards mirrored
+	Side toMove = SOUTH;
+	for(size_t ply = 0; ply < 60; ply++) {
+		size_t nMoves, mMoves;
+		const uint8_t* moves = b.validMoves(toMove, nMoves);
+		const uint8_t* mirroredMoves = m.validMoves(Side(toMove ^ 1), mMoves);
+
+		ASSERT_EQ(nMoves, mMoves);
+		if(nMoves == 0) break;
+		for(size_t i = 0; i < nMoves; i++) {
+			ASSERT_EQ(moves[i], mirroredMoves[i]);
+		}
+
+		uint8_t move = moves[(ply * 5) % nMoves];
+		bool again = b.makeMove(toMove, move);
+		ASSERT_EQ(again, m.makeMove(Side(toMove ^ 1), move));
+		ASSERT_TRUE(b.mirrored() == m);
+		ASSERT_TRUE(canonical(b, NORTH) == canonical(m, SOUTH));
+
+		if(!again) toMove = Side(toMove ^ 1);
+	}
+}
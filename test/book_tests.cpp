@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include <mancala/Board.hpp>
+#include <mancala/Book.hpp>
+#include <mancala/books.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+TEST(Book, EmbeddedBook) {
+	// The old south and north books together, less the positions both had
+	EXPECT_EQ(15983u, books::size());
+
+	// North has an answer to every first move
+	Board b;
+	b.reset();
+	for(uint8_t i = 0; i < 7; i++) {
+		Board cpy = b;
+		cpy.makeMove(SOUTH, i);
+
+		uint8_t move = books::find(NORTH, cpy);
+		EXPECT_NE(Book::NO_MOVE, move);
+		EXPECT_EQ(move, books::find(SOUTH, cpy.mirrored()));
+
+		// The shipped book predates values
+		EXPECT_EQ(Book::NO_VALUE, books::value(NORTH, cpy));
+	}
+
+	Board late;
+	late.clear();
+	late.stonesInWell(SOUTH) = 48;
+	late.stonesInWell(NORTH) = 48;
+	late.stonesInHole(SOUTH, 0) = 2;
+	late.recalcMoves();
+	EXPECT_EQ(Book::NO_MOVE, books::find(SOUTH, late));
+
+	// Every entry lands in its own slot
+	for(size_t i = 0; i < books::size(); i++) {
+		auto e = books::entry(i);
+		ASSERT_EQ(e.second, books::find(SOUTH, e.first));
+		ASSERT_EQ(e.second, books::find(NORTH, e.first.mirrored()));
+	}
+}
+
+TEST(Book, RoundTrip) {
+	std::vector<std::pair<Board, uint8_t>> entries;
+	std::vector<float> values;
+
+	Board b;
+	b.reset();
+	for(uint8_t i = 0; i < 7; i++) {
+		Board cpy = b;
+		cpy.makeMove(SOUTH, i);
+		entries.emplace_back(cpy, 6 - i);
+		values.push_back(i / 6.0f);
+	}
+	// One without a value
+	values.back() = -1.0f;
+
+	std::vector<uint8_t> bytes = Book::encode(entries, values);
+	ASSERT_EQ(Book::HEADER_BYTES + 7 * Book::ENTRY_BYTES, bytes.size());
+
+	Book book = Book::view(bytes.data(), bytes.size());
+	ASSERT_TRUE(book.verify());
+	for(size_t i = 0; i < entries.size(); i++) {
+		EXPECT_EQ(entries[i].second, book.find(entries[i].first));
+		if(i + 1 < entries.size()) {
+			EXPECT_NEAR(values[i], book.value(entries[i].first), 1e-4);
+		}
+	}
+	EXPECT_EQ(Book::NO_VALUE, book.value(entries.back().first));
+	EXPECT_EQ(Book::NO_MOVE, book.find(b));
+	EXPECT_EQ(Book::NO_VALUE, book.value(b));
+
+	// From a file
+	const char* path = "book_tests.mkb";
+	std::ofstream(path, std::ios::binary).write((const char*) bytes.data(), bytes.size());
+
+	Book mapped = Book::open(path);
+	std::remove(path);
+
+	ASSERT_TRUE(mapped.verify());
+	EXPECT_EQ(entries[3].second, mapped.find(entries[3].first));
+}
+
+TEST(Book, RejectsBadData) {
+	Board b;
+	b.reset();
+	std::vector<uint8_t> bytes = Book::encode({ std::make_pair(b, uint8_t(3)) });
+
+	EXPECT_FALSE(Book::view(bytes.data(), bytes.size() - 1).valid());
+	EXPECT_FALSE(Book::open("no/such/book.mkb").valid());
+
+	std::vector<uint8_t> newer = bytes;
+	newer[4] = Book::VERSION + 1;
+	EXPECT_FALSE(Book::view(newer.data(), newer.size()).valid());
+
+	// Looks fine until the checksum is checked
+	std::vector<uint8_t> flipped = bytes;
+	flipped.back() ^= 1;
+	Book book = Book::view(flipped.data(), flipped.size());
+	EXPECT_TRUE(book.valid());
+	EXPECT_FALSE(book.verify());
+
+	EXPECT_EQ(Book::NO_MOVE, Book().find(b));
+}
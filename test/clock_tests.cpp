@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+
+#include <mancala/Board.hpp>
+#include <mancala/Clock.hpp>
+
+#include <algorithm>
+
+TEST(Clock, SpreadsTimeOverTheGame) {
+	Clock clock(600.0, 0.0, 10.0);
+
+	Board b;
+	b.reset();
+
+	double first = clock.startMove(b, SOUTH);
+	EXPECT_GT(first, 5.0);
+	EXPECT_LT(first, 600.0 / 20);
+
+	clock.endMove(first);
+	EXPECT_DOUBLE_EQ(600.0 - first, clock.remaining());
+
+	// Fewer stones left means fewer moves to save time for
+	Board late;
+	late.clear();
+	late.stonesInWell(SOUTH) = 40;
+	late.stonesInWell(NORTH) = 40;
+	for(size_t i = 0; i < 6; i++) {
+		late.stonesInHole(SOUTH, i) = 2;
+		late.stonesInHole(NORTH, i) = 1;
+	}
+	late.recalcMoves();
+
+	Clock other(600.0 - first, 0.0, 10.0);
+	EXPECT_GT(other.startMove(late, SOUTH), first);
+}
+
+TEST(Clock, KeepsTheMargin) {
+	Clock clock(100.0, 0.0, 10.0);
+
+	Board b;
+	b.reset();
+
+	for(size_t i = 0; i < 40; i++) {
+		double budget = clock.startMove(b, SOUTH);
+		EXPECT_LE(budget, std::max(0.05, (clock.remaining() - 10.0) / 4));
+		clock.endMove(budget);
+	}
+
+	EXPECT_GT(clock.remaining(), 8.0);
+}
+
+TEST(Clock, OverrunsShrinkBudgets) {
+	Board b;
+	b.reset();
+
+	Clock late(1000.0);
+	Clock onTime(1000.0);
+
+	// Both spend the same, but only one of them was told to spend less
+	double budget = late.startMove(b, SOUTH);
+	late.endMove(2 * budget);
+	onTime.endMove(2 * budget);
+	ASSERT_DOUBLE_EQ(onTime.remaining(), late.remaining());
+
+	EXPECT_LT(late.startMove(b, SOUTH), onTime.startMove(b, SOUTH));
+}
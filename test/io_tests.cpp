@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include <mancala/input.hpp>
+#include <mancala/output.hpp>
 
 #include <sstream>
 
@@ -8,31 +9,29 @@ TEST(IO, GameOver) {
 	std::stringstream s;
 	s << "END\n";
 
-	auto ptr = input::parseNext(s);
+	auto msg = input::parseNext(s);
 
-	ASSERT_TRUE(dynamic_cast<input::GameOver*>(ptr.get()));
+	ASSERT_EQ(input::Message::GAME_OVER, msg.type);
 }
 
 TEST(IO, StartNorth) {
 	std::stringstream s;
 	s << "START;North\n";
 
-	auto ptr = input::parseNext(s);
-	input::Start* str = dynamic_cast<input::Start*>(ptr.get());
+	auto msg = input::parseNext(s);
 
-	ASSERT_TRUE(str);
-	EXPECT_EQ(NORTH, str->side);
+	ASSERT_EQ(input::Message::START, msg.type);
+	EXPECT_EQ(NORTH, msg.side);
 }
 
 TEST(IO, StartSouth) {
 	std::stringstream s;
 	s << "START;South\n";
 
-	auto ptr = input::parseNext(s);
-	input::Start* str = dynamic_cast<input::Start*>(ptr.get());
+	auto msg = input::parseNext(s);
 
-	ASSERT_TRUE(str);
-	EXPECT_EQ(SOUTH, str->side);
+	ASSERT_EQ(input::Message::START, msg.type);
+	EXPECT_EQ(SOUTH, msg.side);
 }
 
 TEST(IO, Change) {
@@ -42,20 +41,43 @@ TEST(IO, Change) {
 	  << "9,10,11,12,13,14,15,16;"
 	  << "YOU\n";
 
-	auto ptr = input::parseNext(s);
-
-	input::Change* chng = dynamic_cast<input::Change*>(ptr.get());
+	auto msg = input::parseNext(s);
 	
-	ASSERT_TRUE(chng);
+	ASSERT_EQ(input::Message::CHANGE, msg.type);
 	
-	EXPECT_EQ(7, chng->lastMove);
-	EXPECT_TRUE(chng->ourTurn);
+	EXPECT_EQ(7, msg.lastMove);
+	EXPECT_TRUE(msg.ourTurn);
 	
 	for(size_t i = 0; i < 7; i++) {
-		EXPECT_EQ(i+1, chng->current.stonesInHole(NORTH, i));
-		EXPECT_EQ(i+9, chng->current.stonesInHole(SOUTH, i));
+		EXPECT_EQ(i+1, msg.current.stonesInHole(NORTH, i));
+		EXPECT_EQ(i+9, msg.current.stonesInHole(SOUTH, i));
 	}
 
-	EXPECT_EQ(8, chng->current.stonesInWell(NORTH));
-	EXPECT_EQ(16, chng->current.stonesInWell(SOUTH));
+	EXPECT_EQ(8, msg.current.stonesInWell(NORTH));
+	EXPECT_EQ(16, msg.current.stonesInWell(SOUTH));
+}
+
+TEST(IO, OneLineAtATime) {
+	std::stringstream s;
+	s << "CHANGE;3;7,7,7,7,7,7,7,0,7,7,0,8,8,8,8,1;OPP\n"
+	  << std::string(200, 'x') << "\n"
+	  << "END\n";
+
+	auto msg = input::parseNext(s);
+	ASSERT_EQ(input::Message::CHANGE, msg.type);
+	EXPECT_EQ(2, msg.lastMove);
+	EXPECT_FALSE(msg.ourTurn);
+	EXPECT_EQ(0, msg.current.stonesInHole(SOUTH, 2));
+	EXPECT_EQ(1, msg.current.stonesInWell(SOUTH));
+
+	// A line too long for any message is skipped as a whole
+	EXPECT_EQ(input::Message::NO_INPUT, input::parseNext(s).type);
+	EXPECT_EQ(input::Message::GAME_OVER, input::parseNext(s).type);
+	EXPECT_EQ(input::Message::NO_INPUT, input::parseNext(s).type);
+}
+
+TEST(IO, Moves) {
+	EXPECT_EQ("MOVE;1\n", output::move(0));
+	EXPECT_EQ("MOVE;7\n", output::move(6));
+	EXPECT_EQ("SWAP\n", output::move(7));
 }
@@ -0,0 +1,357 @@
+#include <gtest/gtest.h>
+
+#include <mancala/MCAgent.hpp>
+#include <mancala/MiniMaxAgent.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+TEST(MCAgent, ProvesWin) {
+	MCAgent agent(10000, 1, 100000);
+
+	// Only hole 6 takes south past 49 stones
+	Board b;
+	b.clear();
+	b.stonesInWell(SOUTH) = 49;
+	b.stonesInWell(NORTH) = 30;
+	b.stonesInHole(SOUTH, 0) = 5;
+	b.stonesInHole(SOUTH, 6) = 1;
+	b.stonesInHole(NORTH, 2) = 13;
+	b.recalcMoves();
+
+	auto res = agent.makeMoveAndScore(b, SOUTH, 30, 0);
+
+	EXPECT_EQ(6, res.first);
+	EXPECT_FLOAT_EQ(1.0, res.second);
+}
+
+TEST(MCAgent, ProvesLoss) {
+	// Whatever south does it runs out of stones with north holding more
+	Board b;
+	b.clear();
+	b.stonesInWell(SOUTH) = 44;
+	b.stonesInWell(NORTH) = 44;
+	b.stonesInHole(SOUTH, 5) = 2;
+	b.stonesInHole(SOUTH, 6) = 1;
+	b.stonesInHole(NORTH, 0) = 2;
+	b.stonesInHole(NORTH, 1) = 3;
+	b.stonesInHole(NORTH, 4) = 2;
+	b.recalcMoves();
+
+	// With transpositions the losses reach every parent of a shared node
+	for(bool dag : { false, true }) {
+		MCAgent agent(10000, 1, 100000);
+		agent.useTranspositions() = dag;
+
+		auto res = agent.makeMoveAndScore(b, SOUTH, 30, 0);
+
+		EXPECT_FLOAT_EQ(0.0, res.second);
+	}
+}
+
+TEST(MCAgent, Transpositions) {
+	// Small enough that the graph has to be pruned a few times
+	MCAgent agent(500, 1, 20000);
+	agent.useTranspositions() = true;
+
+	Board b;
+	b.reset();
+	b.makeMove(SOUTH, 3);
+
+	auto res = agent.makeMoveAndScore(b, NORTH, 2, 3);
+	EXPECT_LT(res.first, 7);
+	EXPECT_GE(res.second, 0.0);
+	EXPECT_LE(res.second, 1.0);
+
+	bool again = b.makeMove(NORTH, res.first);
+	EXPECT_TRUE(agent.hasTreeFor(b, again ? NORTH : SOUTH));
+
+	// Switching modes throws the graph away
+	agent.useTranspositions() = false;
+	EXPECT_FALSE(agent.hasTreeFor(b, again ? NORTH : SOUTH));
+}
+
+TEST(MCAgent, ReusesTreeAcrossMoves) {
+	for(bool dag : { false, true }) {
+		// Far too small for a whole search, so every move collects and
+		// recycles nodes, then reroots what is left for the next one
+		MCAgent agent(300, 1, 3000);
+		agent.useTranspositions() = dag;
+
+		Board b;
+		b.reset();
+		b.makeMove(SOUTH, 3);
+		Side s = NORTH;
+
+		for(size_t ply = 0; ply < 10; ply++) {
+			auto res = agent.makeMoveAndScore(b, s, 2 + ply, 0);
+
+			size_t nMoves;
+			const uint8_t* moves = b.validMoves(s, nMoves);
+			EXPECT_NE(moves + nMoves, std::find(moves, moves + nMoves, res.first));
+			EXPECT_GE(res.second, 0.0);
+			EXPECT_LE(res.second, 1.0);
+
+			// The chosen move is in the tree, the next search starts from it
+			if(!b.makeMove(s, res.first)) s = Side(int(s)^1);
+			EXPECT_TRUE(agent.hasTreeFor(b, s));
+		}
+	}
+}
+
+TEST(MCAgent, KeepsProofsAcrossMoves) {
+	// South wins these by force, but not within one search's horizon. Holes
+	// south then north, then the wells.
+	const uint8_t starts[2][16] = {
+		{ 1, 1, 1, 0, 2, 2, 1,  2, 0, 3, 0, 1, 1, 2,  38, 43 },
+		{ 1, 0, 1, 3, 0, 1, 1,  2, 3, 2, 0, 0, 1, 2,  42, 39 },
+	};
+
+	for(const auto& start : starts) {
+		// A plain tree, shared transpositions and the hybrid alpha-beta
+		for(size_t mode = 0; mode < 3; mode++) {
+			for(size_t game = 0; game < 5; game++) {
+				// Tiny, so proven nodes get collapsed before they become the root
+				MCAgent agent(60, 1, 3000);
+				agent.useTranspositions() = mode == 1;
+				if(mode == 2) {
+					agent.hybridDepth() = 4;
+					agent.hybridVisits() = 4;
+				}
+
+				Board b;
+				b.clear();
+				for(size_t i = 0; i < 7; i++) {
+					b.stonesInHole(SOUTH, i) = start[i];
+					b.stonesInHole(NORTH, i) = start[7 + i];
+				}
+				b.stonesInWell(SOUTH) = start[14];
+				b.stonesInWell(NORTH) = start[15];
+				b.recalcMoves();
+
+				Side s = SOUTH;
+				size_t nMoves;
+				while(b.validMoves(s, nMoves), nMoves > 0 && b.stonesInWell(SOUTH) <= 49 && b.stonesInWell(NORTH) <= 49) {
+					auto res = agent.makeMoveAndScore(b, s, 30, 0);
+					ASSERT_LT(res.first, 7);
+					ASSERT_GE(res.second, 0.0);
+					ASSERT_LE(res.second, 1.0);
+
+					const Side mover = s;
+					if(!b.makeMove(s, res.first)) s = Side(int(s)^1);
+
+					// A move played as a proven win keeps the win
+					b.validMoves(s, nMoves);
+					if(mover == SOUTH && res.second == 1.0 && nMoves > 0 && b.stonesInWell(SOUTH) <= 49) {
+						MiniMaxAgent::MoveCache cache;
+						EXPECT_EQ(1.0 / 0.0, MiniMaxAgent::alphaBeta(b, s, 30, cache).second);
+					}
+				}
+			}
+		}
+	}
+}
+
+TEST(MCAgent, MostPlayed) {
+	MCAgent agent(10000, 1, 5000);
+
+	Board b;
+	b.reset();
+	b.makeMove(SOUTH, 3);
+	EXPECT_EQ(MCAgent::NO_MOVE, agent.mostPlayed(b, NORTH));
+
+	auto res = agent.makeMoveAndScore(b, NORTH, 2, 3);
+	EXPECT_EQ(res.first, agent.mostPlayed(b, NORTH));
+
+	// Not in the tree, south can't be to move here
+	EXPECT_EQ(MCAgent::NO_MOVE, agent.mostPlayed(b, SOUTH));
+}
+
+TEST(MCAgent, Rave) {
+	MCAgent agent(10000, 1, 5000);
+	agent.useRave() = true;
+
+	// Still finds the only winning move
+	Board b;
+	b.clear();
+	b.stonesInWell(SOUTH) = 49;
+	b.stonesInWell(NORTH) = 30;
+	b.stonesInHole(SOUTH, 0) = 5;
+	b.stonesInHole(SOUTH, 6) = 1;
+	b.stonesInHole(NORTH, 2) = 13;
+	b.recalcMoves();
+
+	auto res = agent.makeMoveAndScore(b, SOUTH, 30, 0);
+	EXPECT_EQ(6, res.first);
+	EXPECT_FLOAT_EQ(1.0, res.second);
+
+	b.reset();
+	res = agent.makeMoveAndScore(b, SOUTH, 2, 0);
+	EXPECT_LT(res.first, 7);
+	EXPECT_GT(res.second, 0.0);
+	EXPECT_LT(res.second, 1.0);
+}
+
+TEST(MCAgent, NoTimeSpentOnForcedMove) {
+	MCAgent agent(10000, 1, 1);
+	agent.useIterations() = false;
+	agent.timePerMove() = 5.0;
+
+	// South can only play hole 3, and the game goes on afterwards
+	Board b;
+	b.clear();
+	b.stonesInWell(SOUTH) = 30;
+	b.stonesInWell(NORTH) = 30;
+	b.stonesInHole(SOUTH, 3) = 2;
+	b.stonesInHole(NORTH, 1) = 20;
+	b.stonesInHole(NORTH, 4) = 16;
+	b.recalcMoves();
+
+	auto start = std::chrono::steady_clock::now();
+	auto res = agent.makeMoveAndScore(b, SOUTH, 30, 0);
+	double took = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	EXPECT_EQ(3, res.first);
+	EXPECT_TRUE(std::isfinite(res.second));
+	EXPECT_GE(res.second, 0.0);
+	EXPECT_LE(res.second, 1.0);
+	EXPECT_LT(took, 1.0);
+
+	// The move got a node of its own to score it
+	EXPECT_EQ(3, agent.mostPlayed(b, SOUTH));
+}
+
+TEST(MCAgent, StopsOnceMoveIsSettled) {
+	MCAgent agent(500000, 4, 1);
+	agent.useIterations() = false;
+	agent.timePerMove() = 1.0;
+
+	// Hole 5 gets another turn and nothing else comes close, but the game is
+	// too far from over to prove it
+	Board b;
+	b.clear();
+	uint8_t south[7] = { 0, 1, 1, 2, 2, 2, 14 };
+	uint8_t north[7] = { 1, 14, 0, 3, 13, 2, 5 };
+	for(size_t i = 0; i < 7; i++) {
+		b.stonesInHole(SOUTH, i) = south[i];
+		b.stonesInHole(NORTH, i) = north[i];
+	}
+	b.stonesInWell(SOUTH) = 20;
+	b.stonesInWell(NORTH) = 18;
+	b.recalcMoves();
+
+	auto start = std::chrono::steady_clock::now();
+	auto res = agent.makeMoveAndScore(b, SOUTH, 30, 0);
+	double took = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	EXPECT_EQ(5, res.first);
+	EXPECT_LT(res.second, 1.0);
+	EXPECT_LT(took, 0.8);
+}
+
+TEST(MCAgent, ExtendsCloseRace) {
+	// Every leaf scores a coin flip, so the moves stay neck and neck
+	Board b;
+	b.reset();
+
+	for(bool manage : { true, false }) {
+		MCAgent agent(100000, 1, 1);
+		agent.useIterations() = false;
+		agent.timePerMove() = 0.5;
+		agent.manageTime() = manage;
+		agent.leafMode() = MCAgent::EVALUATE;
+		agent.evalScale() = 0.0f;
+
+		auto start = std::chrono::steady_clock::now();
+		agent.makeMoveAndScore(b, SOUTH, 30, 0);
+		double took = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		EXPECT_GE(took, 0.5);
+		if(manage) {
+			EXPECT_GT(took, 0.7);
+		} else {
+			EXPECT_LT(took, 0.7);
+		}
+	}
+}
+
+TEST(MCAgent, LeafModes) {
+	for(auto mode : { MCAgent::EVALUATE, MCAgent::TRUNCATED }) {
+		MCAgent agent(10000, 4, 5000);
+		agent.leafMode() = mode;
+
+		Board b;
+		b.clear();
+		b.stonesInWell(SOUTH) = 49;
+		b.stonesInWell(NORTH) = 30;
+		b.stonesInHole(SOUTH, 0) = 5;
+		b.stonesInHole(SOUTH, 6) = 1;
+		b.stonesInHole(NORTH, 2) = 13;
+		b.recalcMoves();
+
+		auto res = agent.makeMoveAndScore(b, SOUTH, 30, 0);
+		EXPECT_EQ(6, res.first);
+
+		b.reset();
+		res = agent.makeMoveAndScore(b, SOUTH, 2, 0);
+		EXPECT_GT(res.second, 0.0);
+		EXPECT_LT(res.second, 1.0);
+	}
+}
+
+TEST(MCAgent, HybridSeesShortWins) {
+	// A handful of iterations, far too few for the playouts to find the win
+	MCAgent agent(10000, 100, 6);
+	agent.hybridDepth() = 4;
+	agent.hybridVisits() = 0;
+
+	// South wins by force within a few plies, starting with hole 3
+	Board b;
+	b.clear();
+	b.stonesInWell(SOUTH) = 36;
+	b.stonesInWell(NORTH) = 47;
+	b.stonesInHole(SOUTH, 0) = 2;
+	b.stonesInHole(SOUTH, 1) = 1;
+	b.stonesInHole(SOUTH, 2) = 1;
+	b.stonesInHole(SOUTH, 3) = 4;
+	b.stonesInHole(NORTH, 3) = 7;
+	b.recalcMoves();
+
+	auto res = agent.makeMoveAndScore(b, SOUTH, 30, 0);
+
+	EXPECT_EQ(3, res.first);
+	EXPECT_FLOAT_EQ(1.0, res.second);
+}
+
+TEST(MCAgent, Stops) {
+	std::atomic<bool> stop(true);
+
+	MCAgent agent(10000, 1, 1);
+	agent.useIterations() = false;
+	agent.timePerMove() = 10.0;
+	agent.stop() = &stop;
+
+	Board b;
+	b.reset();
+
+	auto start = std::chrono::steady_clock::now();
+	auto res = agent.makeMoveAndScore(b, SOUTH, 2, 0);
+	double took = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	EXPECT_LT(res.first, 7);
+	EXPECT_LT(took, 1.0);
+}
+
+TEST(MCAgent, BytesPerNode) {
+	MCAgent agent(1000, 1, 1);
+	size_t plain = agent.bytesPerNode();
+
+	agent.useTranspositions() = true;
+	size_t dag = agent.bytesPerNode();
+	EXPECT_GT(dag, plain);
+
+	agent.useRave() = true;
+	EXPECT_GT(agent.bytesPerNode(), dag);
+}
@@ -0,0 +1,221 @@
+#include <gtest/gtest.h>
+
+#include <mancala/Board.hpp>
+#include <mancala/playout.hpp>
+#include <mancala/batchplayout.hpp>
+
+#include <cstring>
+#include <tuple>
+
+static void expectSame(const Board& b, const playout::Pits& p) {
+	for(size_t i = 0; i < 7; i++) {
+		EXPECT_EQ(b.stonesInHole(NORTH, i), p.hole(NORTH, i));
+		EXPECT_EQ(b.stonesInHole(SOUTH, i), p.hole(SOUTH, i));
+	}
+
+	EXPECT_EQ(b.stonesInWell(NORTH), p.well(NORTH));
+	EXPECT_EQ(b.stonesInWell(SOUTH), p.well(SOUTH));
+}
+
+TEST(Playout, RngBelow) {
+	playout::Rng rng(42);
+	size_t seen[7] = { 0 };
+
+	for(size_t i = 0; i < 7000; i++) {
+		uint32_t r = rng.below(7);
+		ASSERT_LT(r, 7u);
+		seen[r]++;
+	}
+
+	for(size_t i = 0; i < 7; i++) {
+		EXPECT_GT(seen[i], 800u);
+	}
+}
+
+TEST(Playout, MoveMask) {
+	Board b;
+	b.clear();
+	b.stonesInHole(SOUTH, 0) = 1;
+	b.stonesInHole(SOUTH, 6) = 200;
+	b.stonesInHole(NORTH, 3) = 128;
+	b.stonesInWell(SOUTH) = 5;
+
+	playout::Pits p(b);
+
+	EXPECT_EQ(0x41, p.moveMask(SOUTH));
+	EXPECT_EQ(0x08, p.moveMask(NORTH));
+}
+
+TEST(Playout, PickMove) {
+	playout::Rng rng(7);
+
+	for(size_t i = 0; i < 100; i++) {
+		size_t m = playout::pickMove(0x52, rng);
+		EXPECT_TRUE(m == 1 || m == 4 || m == 6);
+	}
+
+	EXPECT_EQ(3u, playout::pickMove(0x08, rng));
+}
+
+TEST(Playout, SameRulesAsBoard) {
+	playout::Rng rng(1234);
+
+	for(size_t game = 0; game < 200; game++) {
+		Board b;
+		b.reset();
+		playout::Pits p(b);
+		Side toMove = SOUTH;
+
+		while(true) {
+			size_t nMoves;
+			const uint8_t* moves = b.validMoves(toMove, nMoves);
+			ASSERT_EQ(nMoves, size_t(__builtin_popcount(p.moveMask(toMove))));
+			if(nMoves == 0) break;
+
+			uint8_t move = moves[rng.below(nMoves)];
+			bool bAgain = b.makeMove(toMove, move);
+			bool pAgain = p.makeMove(toMove, move);
+
+			ASSERT_EQ(bAgain, pAgain);
+			expectSame(b, p);
+
+			if(!bAgain) toMove = Side(toMove ^ 1);
+		}
+	}
+}
+
+TEST(Playout, BigHoleMatchesBoard) {
+	for(uint8_t stones = 14; stones < 48; stones++) {
+		for(size_t hole = 0; hole < 7; hole++) {
+			Board b;
+			b.clear();
+			b.stonesInHole(NORTH, hole) = stones;
+			b.stonesInHole(SOUTH, 6 - ((hole + stones) % 15 % 7)) = 3;
+			b.recalcMoves();
+
+			playout::Pits p(b);
+
+			EXPECT_EQ(b.makeMove(NORTH, hole), p.makeMove(NORTH, hole));
+			expectSame(b, p);
+		}
+	}
+}
+
+TEST(Playout, FinishedGames) {
+	playout::Rng rng(99);
+	Board b;
+
+	b.clear();
+	b.stonesInWell(SOUTH) = 50;
+	b.stonesInHole(NORTH, 0) = 48;
+	b.recalcMoves();
+	EXPECT_EQ(playout::SOUTH_WON, playout::play(playout::Pits(b), NORTH, rng));
+
+	// South can't move, north keeps what is on its side
+	b.clear();
+	b.stonesInWell(SOUTH) = 45;
+	b.stonesInWell(NORTH) = 45;
+	b.stonesInHole(NORTH, 2) = 8;
+	b.recalcMoves();
+	EXPECT_EQ(playout::NORTH_WON, playout::play(playout::Pits(b), SOUTH, rng));
+
+	b.clear();
+	b.stonesInWell(SOUTH) = 49;
+	b.stonesInWell(NORTH) = 45;
+	b.stonesInHole(NORTH, 2) = 4;
+	b.recalcMoves();
+	EXPECT_EQ(playout::DRAW, playout::play(playout::Pits(b), SOUTH, rng));
+
+	auto res = playout::randomPlayouts(b, SOUTH, 10);
+	EXPECT_EQ(10u, std::get<0>(res));
+	EXPECT_EQ(10u, std::get<1>(res));
+}
+
+TEST(Playout, Advance) {
+	playout::Rng rng(3);
+
+	Board b;
+	b.reset();
+	playout::Pits p(b);
+	Side toMove = SOUTH;
+
+	EXPECT_TRUE(playout::advance(p, toMove, 4, rng));
+	expectSame(p.toBoard(), p);
+
+	// Runs into the end of the game and says who won
+	EXPECT_FALSE(playout::advance(p, toMove, 1000, rng));
+
+	playout::Result r = playout::outcome(p, toMove);
+	playout::Pits q = p;
+	EXPECT_EQ(r, playout::play(q, toMove, rng));
+}
+
+TEST(Playout, MoveCounts) {
+	Board b;
+	b.clear();
+	b.stonesInWell(SOUTH) = 40;
+	b.stonesInWell(NORTH) = 40;
+	b.stonesInHole(SOUTH, 2) = 1;
+	b.stonesInHole(NORTH, 0) = 10;
+	b.stonesInHole(NORTH, 5) = 7;
+	b.recalcMoves();
+
+	playout::MoveCounts counts;
+	memset(&counts, 0, sizeof(counts));
+
+	const size_t games = 50;
+	auto res = playout::randomPlayouts(b, SOUTH, games, counts);
+
+	// South's only move comes up in every game
+	EXPECT_EQ(2 * games, counts.plays[SOUTH][2]);
+	EXPECT_EQ(std::get<0>(res), counts.wins[SOUTH][2]);
+
+	for(size_t i = 0; i < 7; i++) {
+		EXPECT_LE(counts.wins[SOUTH][i], counts.plays[SOUTH][i]);
+		EXPECT_LE(counts.wins[NORTH][i], counts.plays[NORTH][i]);
+	}
+}
+
+TEST(Playout, BatchCountsEveryGame) {
+	Board b;
+	b.reset();
+
+	for(size_t games : { 1, 15, 16, 17, 100 }) {
+		auto res = playout::batchPlayouts(b, SOUTH, games);
+		EXPECT_EQ(2 * games, std::get<0>(res) + std::get<1>(res));
+	}
+
+	// Already decided, every lane finishes straight away
+	b.clear();
+	b.stonesInWell(NORTH) = 50;
+	b.stonesInHole(SOUTH, 4) = 48;
+	b.recalcMoves();
+
+	auto res = playout::batchPlayouts(b, SOUTH, 40);
+	EXPECT_EQ(0u, std::get<0>(res));
+	EXPECT_EQ(80u, std::get<1>(res));
+}
+
+TEST(Playout, BatchMatchesScalar) {
+	const size_t games = 40000;
+
+	Board positions[3];
+	positions[0].reset();
+	positions[1].reset();
+	positions[1].makeMove(SOUTH, 3);
+	positions[2] = positions[1];
+	positions[2].makeMove(NORTH, 6);
+
+	Side toMove[3] = { SOUTH, NORTH, SOUTH };
+
+	for(size_t i = 0; i < 3; i++) {
+		auto scalar = playout::randomPlayouts(positions[i], toMove[i], games);
+		auto batch = playout::batchPlayouts(positions[i], toMove[i], games);
+
+		double scalarRate = std::get<0>(scalar) / (2.0 * games);
+		double batchRate = std::get<0>(batch) / (2.0 * games);
+
+		// Both estimate the same probability, about 6 standard errors apart at most
+		EXPECT_NEAR(scalarRate, batchRate, 0.02);
+	}
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include <mancala/Board.hpp>
+#include <mancala/MiniMaxAgent.hpp>
+#include <mancala/SavageAgent.hpp>
+
+#include <chrono>
+#include <thread>
+
+// Small trees and about a second for a move from the position below
+static const size_t PONDER_MEMORY = size_t(64) << 20;
+static const double PONDER_GAME_TIME = 47.0;
+
+static Board ponderPosition() {
+	Board b;
+	b.clear();
+	uint8_t south[7] = { 3, 4, 5, 2, 6, 1, 4 };
+	uint8_t north[7] = { 5, 2, 6, 3, 4, 7, 2 };
+	for(size_t i = 0; i < 7; i++) {
+		b.stonesInHole(SOUTH, i) = south[i];
+		b.stonesInHole(NORTH, i) = north[i];
+	}
+	b.stonesInWell(SOUTH) = 22;
+	b.stonesInWell(NORTH) = 22;
+	b.recalcMoves();
+	return b;
+}
+
+static double timeMove(SavageAgent& agent, const Board& b, Side s) {
+	auto start = std::chrono::steady_clock::now();
+	uint8_t move = agent.makeMove(b, s, 32, 0);
+	EXPECT_GT(b.stonesInHole(s, move), 0);
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+TEST(SavageAgent, Ponder) {
+	const Board b = ponderPosition();
+
+	// With no trees yet, the agent expects North to play what a shallow
+	// minimax does
+	Board hit = b;
+	Side s = NORTH;
+	while(s != SOUTH) {
+		MiniMaxAgent::MoveCache cache;
+		if(!hit.makeMove(s, MiniMaxAgent::alphaBeta(hit, s, 6, cache).first)) s = SOUTH;
+	}
+
+	// Any other reply that hands the turn over
+	Board miss;
+	for(uint8_t i = 0; i < 7; i++) {
+		miss = b;
+		if(b.stonesInHole(NORTH, i) > 0 && !miss.makeMove(NORTH, i) && !(miss == hit)) break;
+	}
+	ASSERT_FALSE(miss == hit);
+
+	double budget;
+	{
+		SavageAgent agent(PONDER_MEMORY, PONDER_GAME_TIME);
+		budget = timeMove(agent, hit, SOUTH);
+	}
+	EXPECT_GT(budget, 0.5);
+
+	// The trees already spent the move's time on the opponent's
+	{
+		SavageAgent agent(PONDER_MEMORY, PONDER_GAME_TIME);
+		agent.ponder(b, NORTH, 30);
+		std::this_thread::sleep_for(std::chrono::duration<double>(1.5 * budget));
+		EXPECT_LT(timeMove(agent, hit, SOUTH), 0.5 * budget);
+	}
+
+	// A wrong guess gets a search of its own
+	{
+		SavageAgent agent(PONDER_MEMORY, PONDER_GAME_TIME);
+		agent.ponder(b, NORTH, 30);
+		std::this_thread::sleep_for(std::chrono::duration<double>(1.5 * budget));
+		EXPECT_GT(timeMove(agent, miss, SOUTH), 0.7 * budget);
+	}
+}
@@ -0,0 +1,40 @@
+#include <gtest/gtest.h>
+
+#include <mancala/ThreadPool.hpp>
+
+#include <atomic>
+#include <future>
+#include <vector>
+
+TEST(ThreadPool, RunsEveryJob) {
+	std::atomic<int> ran(0);
+	std::vector<std::future<int>> results;
+
+	{
+		ThreadPool pool(3);
+		EXPECT_EQ(3u, pool.size());
+
+		for(int i = 0; i < 50; i++) {
+			results.push_back(pool.submit([&ran, i]() { ran++; return i * i; }));
+		}
+
+		for(int i = 0; i < 50; i++) {
+			EXPECT_EQ(i * i, results[i].get());
+		}
+	}
+
+	EXPECT_EQ(50, ran.load());
+}
+
+TEST(ThreadPool, FinishesQueuedJobsOnShutdown) {
+	std::atomic<int> ran(0);
+
+	{
+		ThreadPool pool(1);
+		for(int i = 0; i < 10; i++) {
+			pool.submit([&ran]() { ran++; });
+		}
+	}
+
+	EXPECT_EQ(10, ran.load());
+}